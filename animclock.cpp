@@ -0,0 +1,71 @@
+//	Fixed-timestep animation clock
+//
+//	Animations advance in whole steps of a fixed length, no matter how often
+//	the event loop gets around to calling them.  advanceAnimationClock( ) is
+//	given the wall-clock time and returns how many steps have come due since
+//	the last call; the leftover carries over to the next call.  After a long
+//	stall (window dragged, debugger, heavy load) at most maxSteps are run, so
+//	the animation skips ahead instead of spending frames catching up.
+//
+//	No OpenGL or GLUT here: the caller supplies the time.
+
+typedef struct AnimationClock {
+    double step;            // seconds per step
+    int maxSteps;           // most steps one advance may return
+    int running;
+    double lastTime;        // wall-clock seconds at the last advance
+    double pending;         // wall-clock seconds not yet turned into steps
+} AnimationClock;
+
+
+void
+initAnimationClock(AnimationClock *c, double step, int maxSteps)
+{
+    c->step = step;
+    c->maxSteps = maxSteps;
+    c->running = 0;
+    c->lastTime = 0.0;
+    c->pending = 0.0;
+}
+
+// Start counting steps from now; does nothing if already running
+void
+startAnimationClock(AnimationClock *c, double now)
+{
+    if(c->running) return;
+    c->running = 1;
+    c->lastTime = now;
+    c->pending = 0.0;
+}
+
+void
+stopAnimationClock(AnimationClock *c)
+{
+    c->running = 0;
+}
+
+// Number of steps due at time now
+int
+advanceAnimationClock(AnimationClock *c, double now)
+{
+    if(!c->running) return 0;
+    double elapsed = now - c->lastTime;
+    c->lastTime = now;
+    if(elapsed > 0.0) c->pending += elapsed;
+
+    int steps = (int)(c->pending / c->step);
+    c->pending -= steps * c->step;
+    if(steps > c->maxSteps) {
+        steps = c->maxSteps;
+        c->pending = 0.0;
+    }
+    return steps;
+}
+
+// Seconds from now until the next step comes due
+double
+secondsToNextStep(const AnimationClock *c, double now)
+{
+    double due = c->step - c->pending - (now - c->lastTime);
+    return due > 0.0 ? due : 0.0;
+}
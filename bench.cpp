@@ -0,0 +1,1378 @@
+//	Command-line benchmarks for the game's graph algorithms
+//
+//	These run without a window, so they only use the GL-free parts of the game.
+//	Build with:
+//		g++ -O2 -std=c++11 -pthread bench.cpp -o bench
+//
+//	Usage:
+//		bench chromatic [threads]
+//		bench levelpack [file]
+//		bench import [graph-file [pack-out]]
+//		bench layout [threads]
+//		bench bvh [nodes]
+//		bench game [moves]
+//		bench bots [threads [games [move-script]]]
+//		bench transition [nodes]
+//		bench morph [nodes]
+//		bench generate [threads [levels [pack-out]]]
+//		bench hint [nodes]
+//		bench tabu [threads [nodes [seconds]]]
+//		bench bitmatrix [nodes]
+//		bench journal [moves]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "graph.cpp"
+#include "bitmatrix.cpp"
+#include "journal.cpp"
+#include "gamecore.cpp"
+#include "chromatic.cpp"
+#include "levelpack.cpp"
+#include "importer.cpp"
+#include "layout.cpp"
+#include "bvh.cpp"
+#include "botdriver.cpp"
+#include "transition.cpp"
+#include "generator.cpp"
+#include "hint.cpp"
+#include "tabucol.cpp"
+
+
+// Every operator new in the program is counted, so a benchmark can report
+// how many heap allocations its timed part made.  All the array and sized
+// forms are replaced too, so every delete frees what our operator new got; the
+// deletes stay out of line or GCC sees free( ) given operator new's pointer
+// and warns about a mismatch that is not there.
+std::atomic<long long> HeapAllocations(0);
+
+void *
+operator new(size_t size)
+{
+    HeapAllocations++;
+    void *p = malloc(size > 0 ? size : 1);
+    if(p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void *
+operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+__attribute__((noinline)) void
+operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void
+operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+__attribute__((noinline)) void
+operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void
+operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+#endif
+
+
+// Random G(n, p) graph with its CSR index built
+Graph
+randomGraph(int numNodes, double edgeProbability, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::vector<Edge> edges;
+    for(int i = 0; i < numNodes; i++) {
+        for(int j = i + 1; j < numNodes; j++) {
+            if(coin(rng) < edgeProbability) {
+                Edge e = {i, j};
+                edges.push_back(e);
+            }
+        }
+    }
+
+    Graph g;
+    memset(&g, 0, sizeof(g));
+    g.numNodes = numNodes;
+    g.nodes = (Node *)calloc(numNodes > 0 ? numNodes : 1, sizeof(Node));
+    g.numEdges = (int)edges.size();
+    g.edges = (Edge *)malloc((edges.size() > 0 ? edges.size() : 1) * sizeof(Edge));
+    if(!g.nodes || !g.edges) {
+        fprintf(stderr, "Memory allocation failed for random graph\n");
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 0; i < numNodes; i++) {
+        g.nodes[i].id = i;
+        g.nodes[i].color = -1;
+    }
+    for(size_t i = 0; i < edges.size(); i++) {
+        g.edges[i] = edges[i];
+    }
+    buildAdjacency(&g);
+    resetColoring(&g);
+    return g;
+}
+
+
+// Random graph with exactly numEdges edges (duplicates possible) and
+// positions spread over the unit cube, for inputs too big for G(n, p)
+Graph
+randomSparseGraph(int numNodes, int numEdges, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> pickNode(0, numNodes - 1);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+
+    Graph g;
+    memset(&g, 0, sizeof(g));
+    g.numNodes = numNodes;
+    g.nodes = (Node *)malloc((numNodes > 0 ? numNodes : 1) * sizeof(Node));
+    g.numEdges = numEdges;
+    g.edges = (Edge *)malloc((numEdges > 0 ? numEdges : 1) * sizeof(Edge));
+    if(!g.nodes || !g.edges) {
+        fprintf(stderr, "Memory allocation failed for random graph\n");
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 0; i < numNodes; i++) {
+        g.nodes[i].id = i;
+        g.nodes[i].position[0] = coord(rng);
+        g.nodes[i].position[1] = coord(rng);
+        g.nodes[i].position[2] = coord(rng);
+        g.nodes[i].color = -1;
+    }
+    for(int i = 0; i < numEdges; i++) {
+        int from = pickNode(rng);
+        int to = pickNode(rng);
+        while(to == from) to = pickNode(rng);
+        g.edges[i].from = from;
+        g.edges[i].to = to;
+    }
+    return g;
+}
+
+
+static double
+secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Exact chromatic number on one thread versus numThreads threads
+int
+benchChromatic(int numThreads)
+{
+    struct { int n; double p; unsigned int seed; } cases[] = {
+        { 80, 0.30, 1 },
+        { 90, 0.30, 1 },
+        { 65, 0.50, 3 },
+        { 55, 0.70, 4 },
+        { 60, 0.70, 4 },
+    };
+    const double BUDGET = 120.0;
+
+    printf("%-14s %6s %6s %10s %12s %10s %12s %8s\n",
+           "graph", "edges", "chi", "1t sec", "1t nodes", "Nt sec", "Nt nodes", "speedup");
+    double total1 = 0.0, totalN = 0.0;
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        Graph g = randomGraph(cases[i].n, cases[i].p, cases[i].seed);
+        ChromaticResult one = computeChromaticNumber(g, BUDGET, NULL, 1);
+        ChromaticResult many = computeChromaticNumber(g, BUDGET, NULL, numThreads);
+        if(one.numColors != many.numColors && one.exact && many.exact) {
+            fprintf(stderr, "Mismatch on case %d: %d vs %d colors\n", (int)i, one.numColors, many.numColors);
+            return 1;
+        }
+
+        char name[32];
+        sprintf(name, "G(%d,%.2f)", cases[i].n, cases[i].p);
+        printf("%-14s %6d %5d%s %10.3f %12lld %10.3f %12lld %7.2fx\n",
+               name, g.numEdges, many.numColors, many.exact ? " " : "?",
+               one.seconds, one.searchNodes, many.seconds, many.searchNodes,
+               many.seconds > 0.0 ? one.seconds / many.seconds : 0.0);
+        total1 += one.seconds;
+        totalN += many.seconds;
+        freeGraph(&g);
+    }
+    printf("total: 1 thread %.3f s, %d threads %.3f s, speedup %.2fx\n",
+           total1, numThreads, totalN, totalN > 0.0 ? total1 / totalN : 0.0);
+    return 0;
+}
+
+
+// Write a pack of large random levels, then time mapping it back in
+int
+benchLevelPack(const char *path)
+{
+    const int NUM_PACK_LEVELS = 16;
+    const int PACK_NODES = 100000;
+    const int PACK_EDGES = 400000;
+
+    Graph graphs[NUM_PACK_LEVELS];
+    for(int i = 0; i < NUM_PACK_LEVELS; i++) {
+        graphs[i] = randomSparseGraph(PACK_NODES, PACK_EDGES, 100 + i);
+        graphs[i].optimalColors = 0;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if(!writeLevelPack(path, graphs, NUM_PACK_LEVELS)) {
+        return 1;
+    }
+    double writeSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    LevelPack pack;
+    if(!openLevelPack(path, &pack)) {
+        return 1;
+    }
+    double openSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for(int i = 0; i < pack.numLevels; i++) {
+        buildAdjacency(&pack.levels[i]);
+    }
+    double adjacencySeconds = secondsSince(start);
+
+    // the pack must give back exactly what was written
+    for(int i = 0; i < NUM_PACK_LEVELS; i++) {
+        Graph *a = &graphs[i];
+        Graph *b = &pack.levels[i];
+        if(a->numNodes != b->numNodes || a->numEdges != b->numEdges ||
+           memcmp(a->edges, b->edges, a->numEdges * sizeof(Edge)) != 0) {
+            fprintf(stderr, "Level %d did not round-trip\n", i + 1);
+            return 1;
+        }
+        for(int n = 0; n < a->numNodes; n++) {
+            if(memcmp(a->nodes[n].position, b->nodes[n].position, sizeof(a->nodes[n].position)) != 0) {
+                fprintf(stderr, "Level %d node %d did not round-trip\n", i + 1, n);
+                return 1;
+            }
+        }
+    }
+
+    printf("%d levels x %d nodes x %d edges, %.1f MB\n",
+           NUM_PACK_LEVELS, PACK_NODES, PACK_EDGES, pack.size / (1024.0 * 1024.0));
+    printf("write:          %8.2f ms\n", 1000.0 * writeSeconds);
+    printf("open (mmap):    %8.2f ms\n", 1000.0 * openSeconds);
+    printf("adjacency:      %8.2f ms\n", 1000.0 * adjacencySeconds);
+
+    for(int i = 0; i < pack.numLevels; i++) {
+        freeGraph(&pack.levels[i]);
+    }
+    closeLevelPack(&pack);
+    for(int i = 0; i < NUM_PACK_LEVELS; i++) {
+        freeGraph(&graphs[i]);
+    }
+    remove(path);
+    return 0;
+}
+
+
+// Parse a DIMACS or edge-list file and report throughput.  With no file,
+// a multi-million-edge DIMACS file is generated first.  With pack-out, the
+// imported graph is also written as a one-level pack.
+int
+benchImport(const char *path, const char *packPath)
+{
+    const char *GENERATED_PATH = "bench_import.col";
+    const int GENERATED_NODES = 1000000;
+    const int GENERATED_EDGES = 4000000;
+
+    bool generated = path == NULL;
+    if(generated) {
+        Graph source = randomSparseGraph(GENERATED_NODES, GENERATED_EDGES, 7);
+        FILE *fp = fopen(GENERATED_PATH, "w");
+        if(fp == NULL) {
+            fprintf(stderr, "Cannot create '%s'\n", GENERATED_PATH);
+            return 1;
+        }
+        fprintf(fp, "c random benchmark graph\np edge %d %d\n", source.numNodes, source.numEdges);
+        for(int i = 0; i < source.numEdges; i++) {
+            fprintf(fp, "e %d %d\n", source.edges[i].from + 1, source.edges[i].to + 1);
+        }
+        fclose(fp);
+        freeGraph(&source);
+        path = GENERATED_PATH;
+    }
+
+    Graph g;
+    ImportStats stats;
+    if(!importGraphFile(path, &g, &stats)) {
+        return 1;
+    }
+    printf("%s: %d nodes, %d edges\n", path, g.numNodes, g.numEdges);
+    printf("lines %lld, edge lines %lld, duplicates %lld, self-loops %lld\n",
+           stats.lines, stats.edgesRead, stats.duplicateEdges, stats.selfLoops);
+    printf("%.1f MB in %.3f s = %.1f MB/s\n", stats.bytes / (1024.0 * 1024.0), stats.seconds,
+           stats.seconds > 0.0 ? stats.bytes / (1024.0 * 1024.0) / stats.seconds : 0.0);
+
+    int status = 0;
+    if(packPath != NULL) {
+        g.optimalColors = 0;
+        status = writeLevelPack(packPath, &g, 1) ? 0 : 1;
+    }
+
+    freeGraph(&g);
+    if(generated) {
+        remove(GENERATED_PATH);
+    }
+    return status;
+}
+
+
+// Force-directed layout time at 1k, 10k and 100k nodes
+int
+benchLayout(int numThreads)
+{
+    const int SIZES[] = { 1000, 10000, 100000 };
+
+    printf("%8s %8s %6s %10s %10s %10s\n", "nodes", "edges", "iters", "seconds", "cached ms", "edge len");
+    for(size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++) {
+        Graph g = randomSparseGraph(SIZES[i], 2 * SIZES[i], 11);
+        buildAdjacency(&g);
+        assignSphereLayout(&g, 1.0f);
+
+        LayoutOptions opts;
+        defaultLayoutOptions(&opts, g.numNodes);
+        opts.numThreads = numThreads;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        computeForceLayout(&g, &opts);
+        double seconds = secondsSince(start);
+
+        // what a layout cache hit costs instead: hash the edges, read the positions
+        const char *CACHE_PATH = "bench_layout.layout";
+        saveLayout(CACHE_PATH, &g);
+        start = std::chrono::steady_clock::now();
+        uint64_t hash[2];
+        hashGraphEdges(&g, hash);
+        int hit = loadLayout(CACHE_PATH, &g);
+        double cachedSeconds = secondsSince(start);
+        remove(CACHE_PATH);
+
+        // mean edge length relative to the [-1,1] cube, as a sanity check
+        double total = 0.0;
+        for(int e = 0; e < g.numEdges; e++) {
+            const float *a = g.nodes[g.edges[e].from].position;
+            const float *b = g.nodes[g.edges[e].to].position;
+            total += sqrt((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+        }
+        printf("%8d %8d %6d %10.3f %10.2f %10.4f\n", g.numNodes, g.numEdges, opts.iterations, seconds,
+               hit ? 1000.0 * cachedSeconds : -1.0, g.numEdges > 0 ? total / g.numEdges : 0.0);
+        freeGraph(&g);
+    }
+    return 0;
+}
+
+
+// Node BVH build, refit and query times
+int
+benchBvh(int numNodes)
+{
+    const int NUM_QUERIES = 10000;
+    const float RADIUS = 0.002f;
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+
+    std::vector<float> positions(3 * (size_t)numNodes);
+    for(size_t i = 0; i < positions.size(); i++) positions[i] = coord(rng);
+
+    NodeBvh bvh;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    buildNodeBvh(&bvh, &positions[0], numNodes, RADIUS);
+    double buildSeconds = secondsSince(start);
+
+    // one transition frame: every node moves a little
+    std::vector<float> moved(positions);
+    for(size_t i = 0; i < moved.size(); i++) moved[i] += 0.05f * coord(rng);
+    start = std::chrono::steady_clock::now();
+    refitNodeBvh(&bvh, &moved[0]);
+    double refitSeconds = secondsSince(start);
+
+    // rays from outside the cube towards random points in it
+    std::vector<float> rays(6 * NUM_QUERIES);
+    for(int q = 0; q < NUM_QUERIES; q++) {
+        float *r = &rays[6 * q];
+        r[0] = coord(rng);  r[1] = coord(rng);  r[2] = 3.0f;
+        r[3] = coord(rng) - r[0];  r[4] = coord(rng) - r[1];  r[5] = -3.0f;
+    }
+    int hits = 0;
+    start = std::chrono::steady_clock::now();
+    for(int q = 0; q < NUM_QUERIES; q++) {
+        if(bvhRayNearest(&bvh, &rays[6 * q], &rays[6 * q + 3]) >= 0) hits++;
+    }
+    double raySeconds = secondsSince(start);
+
+    // check a few rays against testing every sphere
+    for(int q = 0; q < 20; q++) {
+        const float *r = &rays[6 * q];
+        int best = -1;
+        float bestT = FLT_MAX;
+        for(int i = 0; i < numNodes; i++) {
+            float t = raySphere(r, r + 3, &moved[3 * (size_t)i], RADIUS);
+            if(t >= 0.f && t < bestT) {
+                bestT = t;
+                best = i;
+            }
+        }
+        if(best != bvhRayNearest(&bvh, r, r + 3)) {
+            fprintf(stderr, "Ray %d: BVH and brute force disagree\n", q);
+            return 1;
+        }
+    }
+
+    std::vector<int> found;
+    size_t totalFound = 0;
+    start = std::chrono::steady_clock::now();
+    for(int q = 0; q < NUM_QUERIES; q++) {
+        float center[3] = { coord(rng), coord(rng), coord(rng) };
+        found.clear();
+        bvhQuerySphere(&bvh, center, 0.05f, &found);
+        totalFound += found.size();
+    }
+    double sphereSeconds = secondsSince(start);
+
+    printf("%d nodes, %d tree nodes\n", numNodes, (int)bvh.nodes.size());
+    printf("build            %10.1f ms\n", 1000.0 * buildSeconds);
+    printf("refit            %10.1f ms\n", 1000.0 * refitSeconds);
+    printf("ray nearest      %10.2f us/query (%d of %d hit)\n", 1e6 * raySeconds / NUM_QUERIES, hits, NUM_QUERIES);
+    printf("within 0.05      %10.2f us/query (%.1f nodes each)\n", 1e6 * sphereSeconds / NUM_QUERIES,
+           (double)totalFound / NUM_QUERIES);
+    return 0;
+}
+
+
+// Edges whose endpoints share a color, counted the slow way
+static int
+countConflicts(const Graph *g)
+{
+    int conflicts = 0;
+    for(int e = 0; e < g->numEdges; e++) {
+        int a = g->nodes[g->edges[e].from].color;
+        if(a != -1 && a == g->nodes[g->edges[e].to].color) conflicts++;
+    }
+    return conflicts;
+}
+
+
+// Moves per second through the game core, with no window: random moves on
+// a large level, then a greedy player solving every level of a game
+int
+benchGame(long long numMoves)
+{
+    const int NUM_GAME_LEVELS = 4;
+    const int GAME_NODES = 10000;
+    const int GAME_EDGES = 15000;
+
+    Graph graphs[NUM_GAME_LEVELS];
+    for(int i = 0; i < NUM_GAME_LEVELS; i++) {
+        graphs[i] = randomSparseGraph(GAME_NODES, GAME_EDGES, 300 + i);
+        buildAdjacency(&graphs[i]);
+        graphs[i].optimalColors = MAX_COLORS;   // only used for the bonus
+    }
+
+    GameState game;
+    initGame(&game, graphs, NUM_GAME_LEVELS);
+
+    // random recoloring never solves a level this size, so every move lands
+    std::mt19937 rng(23);
+    std::uniform_int_distribution<int> pickNode(0, GAME_NODES - 1);
+    std::uniform_int_distribution<int> pickColor(-1, MAX_COLORS - 1);
+    std::vector<int> moveNodes(1 << 16), moveColors(1 << 16);
+    for(size_t i = 0; i < moveNodes.size(); i++) {
+        moveNodes[i] = pickNode(rng);
+        moveColors[i] = pickColor(rng);
+    }
+    size_t mask = moveNodes.size() - 1;
+    long long applied = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(long long m = 0; m < numMoves; m++) {
+        if(applyMove(&game, moveNodes[m & mask], moveColors[m & mask]) != MOVE_REJECTED) applied++;
+    }
+    double randomSeconds = secondsSince(start);
+    if(graphs[0].numConflicts != countConflicts(&graphs[0])) {
+        fprintf(stderr, "Conflict count drifted: %d kept, %d actual\n", graphs[0].numConflicts, countConflicts(&graphs[0]));
+        return 1;
+    }
+
+    // a greedy player: each node gets the lowest color none of its neighbors has
+    resetGame(&game);
+    long long greedyMoves = 0;
+    start = std::chrono::steady_clock::now();
+    while(!game.gameCompleted) {
+        Graph *g = currentGraph(&game);
+        for(int i = 0; i < g->numNodes && !game.levelSolved; i++) {
+            int used = 0;
+            for(int k = g->adjOffsets[i]; k < g->adjOffsets[i + 1]; k++) {
+                int c = g->nodes[g->adjNeighbors[k]].color;
+                if(c >= 0) used |= 1 << c;
+            }
+            int color = 0;
+            while(color < MAX_COLORS - 1 && (used & (1 << color))) color++;
+            applyMove(&game, i, color);
+            greedyMoves++;
+        }
+        if(!game.levelSolved) {
+            fprintf(stderr, "Greedy player could not solve level %d in %d colors\n", game.currentLevel + 1, MAX_COLORS);
+            return 1;
+        }
+        advanceLevel(&game);
+    }
+    double greedySeconds = secondsSince(start);
+
+    printf("%d levels x %d nodes x %d edges\n", NUM_GAME_LEVELS, GAME_NODES, GAME_EDGES);
+    printf("random moves   %12lld in %8.3f s = %8.2f M moves/s\n", applied, randomSeconds,
+           randomSeconds > 0.0 ? applied / randomSeconds / 1e6 : 0.0);
+    printf("greedy game    %12lld in %8.3f s = %8.2f M moves/s, final score %d\n", greedyMoves, greedySeconds,
+           greedySeconds > 0.0 ? greedyMoves / greedySeconds / 1e6 : 0.0, game.score);
+
+    for(int i = 0; i < NUM_GAME_LEVELS; i++) {
+        freeGraph(&graphs[i]);
+    }
+    return 0;
+}
+
+
+// Many bot games at once through the game core: random players, greedy
+// players, then a replay of the greedy game's moves, which must score the
+// same.  With a move script, that script is replayed instead.
+int
+benchBots(int numThreads, int numGames, const char *scriptPath)
+{
+    const int NUM_BOT_LEVELS = 4;
+    const int BOT_NODES = 2000;
+    const int BOT_EDGES = 3000;
+    const char *RECORDED_PATH = "bench_bots.moves";
+
+    Graph graphs[NUM_BOT_LEVELS];
+    for(int i = 0; i < NUM_BOT_LEVELS; i++) {
+        graphs[i] = randomSparseGraph(BOT_NODES, BOT_EDGES, 400 + i);
+        buildAdjacency(&graphs[i]);
+        resetColoring(&graphs[i]);
+        graphs[i].optimalColors = 3;
+    }
+
+    // record one greedy game by playing it on the levels themselves
+    std::vector<BotMove> script;
+    if(scriptPath != NULL) {
+        if(!loadMoveScript(scriptPath, &script)) return 1;
+    } else {
+        GameState game;
+        initGame(&game, graphs, NUM_BOT_LEVELS);
+        while(!game.gameCompleted) {
+            Graph *g = currentGraph(&game);
+            for(int i = 0; i < g->numNodes && !game.levelSolved; i++) {
+                BotMove m = { i, greedyColor(g, i) };
+                applyMove(&game, m.node, m.color);
+                script.push_back(m);
+            }
+            if(!game.levelSolved) {
+                fprintf(stderr, "Greedy player could not solve level %d\n", game.currentLevel + 1);
+                return 1;
+            }
+            advanceLevel(&game);
+        }
+        resetGame(&game);
+        if(!saveMoveScript(RECORDED_PATH, &script[0], (long long)script.size()) ||
+           !loadMoveScript(RECORDED_PATH, &script)) {
+            return 1;
+        }
+        remove(RECORDED_PATH);
+    }
+
+    BotOptions opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.numGames = numGames;
+    opts.numThreads = numThreads;
+    opts.maxMovesPerGame = 20000;
+    opts.seed = 500;
+    opts.script = script.empty() ? NULL : &script[0];
+    opts.scriptLength = (long long)script.size();
+
+    BotKind kinds[3] = { BOT_RANDOM, BOT_GREEDY, BOT_REPLAY };
+    const char *names[3] = { "random", "greedy", "replay" };
+    BotStats results[3];
+    printf("%d levels x %d nodes x %d edges, %d games each, %d threads\n",
+           NUM_BOT_LEVELS, BOT_NODES, BOT_EDGES, numGames, numThreads);
+    printf("%-8s %12s %10s %10s %8s %8s %10s %10s %8s\n", "bot", "moves", "rejected", "conflicts",
+           "solved", "won", "seconds", "M moves/s", "allocs");
+    for(int k = scriptPath != NULL ? 2 : 0; k < 3; k++) {
+        opts.kind = kinds[k];
+        long long allocationsBefore = HeapAllocations.load();
+        results[k] = runBots(graphs, NUM_BOT_LEVELS, &opts);
+        long long allocations = HeapAllocations.load() - allocationsBefore;
+        BotStats *r = &results[k];
+        printf("%-8s %12lld %10lld %10lld %8lld %8lld %10.3f %10.2f %8lld\n", names[k], r->moves,
+               r->rejectedMoves, r->conflictingMoves, r->levelsSolved, r->gamesCompleted, r->seconds,
+               r->seconds > 0.0 ? (r->moves + r->rejectedMoves) / r->seconds / 1e6 : 0.0, allocations);
+    }
+
+    int status = 0;
+    if(scriptPath == NULL && (results[2].totalScore != results[1].totalScore ||
+                              results[2].gamesCompleted != results[1].gamesCompleted)) {
+        fprintf(stderr, "Replay scored %lld, the greedy games it was recorded from %lld\n",
+                results[2].totalScore, results[1].totalScore);
+        status = 1;
+    }
+
+    for(int i = 0; i < NUM_BOT_LEVELS; i++) {
+        freeGraph(&graphs[i]);
+    }
+    return status;
+}
+
+
+// One axis of one node's path, stored and evaluated the way the game's
+// per-node keyframe objects did it: search the keys, then interpolate
+typedef struct AxisKeys {
+    int numKeys;
+    float times[2];
+    float values[2];
+} AxisKeys;
+
+static float
+axisValue(const AxisKeys *k, float t)
+{
+    int i = 0;
+    while(i < k->numKeys - 2 && t > k->times[i + 1]) i++;
+    float u = (t - k->times[i]) / (k->times[i + 1] - k->times[i]);
+    return k->values[i] + (k->values[i + 1] - k->values[i]) * u;
+}
+
+
+// Evaluating every node's transition position for one frame: three keyframe
+// objects per node against one SoA pass
+int
+benchTransition(int numNodes)
+{
+    const int FRAMES = 120;
+    std::mt19937 rng(29);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+
+    std::vector<float> from(3 * (size_t)numNodes), to(3 * (size_t)numNodes);
+    for(size_t i = 0; i < from.size(); i++) {
+        from[i] = coord(rng);
+        to[i] = coord(rng);
+    }
+
+    std::vector<AxisKeys> perNode(3 * (size_t)numNodes);
+    for(size_t i = 0; i < perNode.size(); i++) {
+        AxisKeys k = { 2, { 0.f, 1.f }, { from[i], to[i] } };
+        perNode[i] = k;
+    }
+    TransitionPaths paths;
+    initTransitionPaths(&paths, numNodes, 2);
+    setTransitionKey(&paths, 0, 0.f, &from[0]);
+    setTransitionKey(&paths, 1, 1.f, &to[0]);
+
+    std::vector<float> scalar(3 * (size_t)numNodes), soa(3 * (size_t)numNodes);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int f = 0; f < FRAMES; f++) {
+        float t = (float)f / (FRAMES - 1);
+        for(size_t i = 0; i < perNode.size(); i++) {
+            scalar[i] = axisValue(&perNode[i], t);
+        }
+    }
+    double scalarSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for(int f = 0; f < FRAMES; f++) {
+        evaluateTransitionPaths(&paths, (float)f / (FRAMES - 1), &soa[0]);
+    }
+    double soaSeconds = secondsSince(start);
+
+    for(size_t i = 0; i < scalar.size(); i++) {
+        if(fabsf(scalar[i] - soa[i]) > 1e-5f) {
+            fprintf(stderr, "Node %d axis %d: %f per node, %f SoA\n", (int)(i / 3), (int)(i % 3), scalar[i], soa[i]);
+            return 1;
+        }
+    }
+
+    printf("%d nodes, %d frames\n", numNodes, FRAMES);
+    printf("per-node keys  %10.3f ms/frame\n", 1000.0 * scalarSeconds / FRAMES);
+    printf("SoA paths      %10.3f ms/frame (%.1fx)\n", 1000.0 * soaSeconds / FRAMES,
+           soaSeconds > 0.0 ? scalarSeconds / soaSeconds : 0.0);
+    return 0;
+}
+
+
+// Planning the morph between levels of different sizes, and what starting
+// a planned transition costs
+int
+benchMorph(int numNodes)
+{
+    struct { int from, to; } cases[] = {
+        { numNodes, numNodes },
+        { numNodes, numNodes + numNodes / 5 },
+        { numNodes + numNodes / 5, numNodes },
+        { 4, 5 },
+    };
+
+    printf("%8s %8s %8s %8s %8s %10s %10s %10s\n", "from", "to", "moved", "spawned", "despawn",
+           "plan ms", "start ms", "mean path");
+    for(size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        Graph from = randomSparseGraph(cases[c].from, 0, 600 + (unsigned int)c);
+        Graph to = randomSparseGraph(cases[c].to, 0, 700 + (unsigned int)c);
+        for(int i = 0; i < from.numNodes; i++) from.nodes[i].color = i % MAX_COLORS;
+
+        TransitionPlan plan;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        planTransition(&from, &to, &plan);
+        double planSeconds = secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        startTransition(&plan, &from);
+        double startSeconds = secondsSince(start);
+
+        // every node of the next level must be reached, and every node of
+        // this one must set off from where it is
+        int m = (int)plan.nodes.size();
+        std::vector<float> begin(3 * (size_t)m), end(3 * (size_t)m);
+        evaluateTransitionPaths(&plan.paths, 0.f, &begin[0]);
+        evaluateTransitionPaths(&plan.paths, 1.f, &end[0]);
+        std::vector<int> used(from.numNodes, 0);
+        double total = 0.0;
+        for(int n = 0; n < m; n++) {
+            const float *a = &begin[3 * (size_t)n], *b = &end[3 * (size_t)n];
+            if(n < to.numNodes && (fabsf(b[0] - to.nodes[n].position[0]) > 1e-5f ||
+                                   fabsf(b[1] - to.nodes[n].position[1]) > 1e-5f ||
+                                   fabsf(b[2] - to.nodes[n].position[2]) > 1e-5f)) {
+                fprintf(stderr, "Morph node %d does not end on its node\n", n);
+                return 1;
+            }
+            int i = plan.source[n];
+            if(i >= 0) {
+                if(memcmp(&begin[3 * (size_t)n], from.nodes[i].position, 3 * sizeof(float)) != 0 ||
+                   plan.nodes[n].color != from.nodes[i].color) {
+                    fprintf(stderr, "Morph node %d does not start from node %d\n", n, i);
+                    return 1;
+                }
+                used[i]++;
+            }
+            total += sqrt((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+        }
+        for(int i = 0; i < from.numNodes; i++) {
+            if(used[i] != 1) {
+                fprintf(stderr, "Node %d starts %d morph nodes\n", i, used[i]);
+                return 1;
+            }
+        }
+
+        printf("%8d %8d %8d %8d %8d %10.2f %10.3f %10.4f\n", from.numNodes, to.numNodes, plan.numMatched,
+               plan.numSpawned, plan.numDespawned, 1000.0 * planSeconds, 1000.0 * startSeconds,
+               m > 0 ? total / m : 0.0);
+        freeGraph(&from);
+        freeGraph(&to);
+    }
+    return 0;
+}
+
+
+// Generated levels per second, written to a pack; the first few are checked
+// to need exactly the planted number of colors
+int
+benchGenerate(int numThreads, int numLevels, const char *packPath)
+{
+    const int NUM_CHECKED = 20;
+
+    GeneratorOptions opts;
+    defaultGeneratorOptions(&opts);
+    opts.numLevels = numLevels;
+    opts.numThreads = numThreads;
+
+    printf("%d levels of %d-%d nodes, %d colors, density %.2f, %d threads\n",
+           numLevels, opts.minNodes, opts.maxNodes, opts.numColors, opts.density, numThreads);
+    GeneratorLayout layouts[3] = { GEN_LAYOUT_CUBE, GEN_LAYOUT_SPHERE, GEN_LAYOUT_FORCE };
+    const char *names[3] = { "cube", "sphere", "force" };
+    int status = 0;
+    for(int l = 0; l < 3 && status == 0; l++) {
+        opts.layout = layouts[l];
+        opts.numLevels = layouts[l] == GEN_LAYOUT_FORCE ? (numLevels + 9) / 10 : numLevels;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Graph *levels = generateLevels(&opts);
+        double seconds = secondsSince(start);
+
+        long long nodes = 0, edges = 0;
+        for(int i = 0; i < opts.numLevels; i++) {
+            nodes += levels[i].numNodes;
+            edges += levels[i].numEdges;
+        }
+        printf("%-7s %8d levels in %8.3f s = %10.0f levels/s (%.1f nodes, %.1f edges each)\n", names[l],
+               opts.numLevels, seconds, seconds > 0.0 ? opts.numLevels / seconds : 0.0,
+               (double)nodes / opts.numLevels, (double)edges / opts.numLevels);
+
+        for(int i = 0; i < NUM_CHECKED && i < opts.numLevels && l == 0; i++) {
+            buildAdjacency(&levels[i]);
+            ChromaticResult chromatic = computeChromaticNumber(levels[i], 10.0, NULL, 0);
+            if(!chromatic.exact || chromatic.numColors != levels[i].optimalColors) {
+                fprintf(stderr, "Level %d: planted %d colors, search found %d%s\n", i + 1,
+                        levels[i].optimalColors, chromatic.numColors, chromatic.exact ? "" : " (not proven)");
+                status = 1;
+            }
+        }
+
+        if(l == 1 && status == 0) {
+            start = std::chrono::steady_clock::now();
+            if(!writeLevelPack(packPath, levels, opts.numLevels)) status = 1;
+            printf("wrote %s in %.3f s\n", packPath, secondsSince(start));
+
+            LevelPack pack;
+            if(status == 0 && openLevelPack(packPath, &pack)) {
+                for(int i = 0; i < pack.numLevels; i++) {
+                    if(pack.levels[i].numEdges != levels[i].numEdges ||
+                       pack.levels[i].optimalColors != levels[i].optimalColors) {
+                        fprintf(stderr, "Level %d did not survive the pack\n", i + 1);
+                        status = 1;
+                        break;
+                    }
+                }
+                if(pack.numLevels != opts.numLevels) status = 1;
+                closeLevelPack(&pack);
+            } else {
+                status = 1;
+            }
+        }
+
+        for(int i = 0; i < opts.numLevels; i++) {
+            freeGraph(&levels[i]);
+        }
+        free(levels);
+    }
+    return status;
+}
+
+
+// Hint latency on a planted 4-colorable level: from an empty board, while
+// following the hints, and from random partial colorings that may be stuck
+int
+benchHint(int numNodes)
+{
+    const double HINT_TIME_BUDGET = 0.005;
+    const int NUM_FOLLOWED = 200;
+    const int NUM_RANDOM = 50;
+
+    GeneratorOptions opts;
+    defaultGeneratorOptions(&opts);
+    opts.numLevels = 1;
+    opts.minNodes = opts.maxNodes = numNodes;
+    opts.numColors = 4;
+    opts.density = numNodes > 11 ? 6.0 / (0.75 * (numNodes - 1)) : 1.0;     // mean degree about 6
+    opts.layout = GEN_LAYOUT_CUBE;
+    opts.numThreads = 1;
+    Graph *level = generateLevels(&opts);
+    Graph *g = &level[0];
+    buildAdjacency(g);
+    resetColoring(g);
+    printf("%d nodes, %d edges, %d colors, %.1f ms budget\n", g->numNodes, g->numEdges,
+           g->optimalColors, 1000.0 * HINT_TIME_BUDGET);
+
+    HintEngine engine;
+    const char *kindNames[] = { "none", "color", "guess", "fix", "blocked" };
+    int status = 0;
+
+    // empty board: a proven hint comes with a whole coloring, which must be proper
+    Hint hint = findHint(&engine, g, 0, HINT_TIME_BUDGET);
+    printf("%-10s %8.3f ms %-8s %lld colorings tried\n", "empty", 1000.0 * hint.seconds,
+           kindNames[hint.kind], hint.searchNodes);
+    if(hint.kind == HINT_COLOR) {
+        for(int e = 0; e < g->numEdges; e++) {
+            int a = engine.color[g->edges[e].from], b = engine.color[g->edges[e].to];
+            if(a < 0 || b < 0 || a >= hint.numColors || a == b) {
+                fprintf(stderr, "Hint search finished with edge %d-%d colored %d and %d\n",
+                        g->edges[e].from, g->edges[e].to, a, b);
+                status = 1;
+                break;
+            }
+        }
+    }
+
+    // following the hints must never make a conflict
+    double total = 0.0, worst = 0.0;
+    int kinds[5] = {0};
+    for(int i = 0; i < NUM_FOLLOWED && status == 0; i++) {
+        hint = findHint(&engine, g, 0, HINT_TIME_BUDGET);
+        total += hint.seconds;
+        if(hint.seconds > worst) worst = hint.seconds;
+        kinds[hint.kind]++;
+        if(hint.node < 0) break;
+        setNodeColor(g, hint.node, hint.color);
+        if(g->numConflicts != 0) {
+            fprintf(stderr, "Hint %d (node %d color %d) made a conflict\n", i, hint.node, hint.color);
+            status = 1;
+        }
+    }
+    printf("%-10s %8.3f ms mean %8.3f ms worst  color %d guess %d fix %d blocked %d\n", "followed",
+           1000.0 * total / NUM_FOLLOWED, 1000.0 * worst, kinds[HINT_COLOR], kinds[HINT_GUESS],
+           kinds[HINT_FIX_CONFLICT], kinds[HINT_BLOCKED]);
+
+    // a player coloring at random soon makes the level unfinishable
+    std::mt19937 rng(900);
+    total = worst = 0.0;
+    memset(kinds, 0, sizeof(kinds));
+    for(int t = 0; t < NUM_RANDOM && status == 0; t++) {
+        resetColoring(g);
+        for(int i = 0; i < g->numNodes * 2 / 5; i++) {
+            int v = (int)(rng() % (unsigned int)g->numNodes);
+            uint32_t open = hintOpenColors(g, NULL, v, g->optimalColors);
+            if(g->nodes[v].color != -1 || open == 0) continue;
+            int c;
+            do c = (int)(rng() % (unsigned int)g->optimalColors); while((open & (1u << c)) == 0);
+            setNodeColor(g, v, c);
+        }
+        hint = findHint(&engine, g, 0, HINT_TIME_BUDGET);
+        total += hint.seconds;
+        if(hint.seconds > worst) worst = hint.seconds;
+        kinds[hint.kind]++;
+    }
+    printf("%-10s %8.3f ms mean %8.3f ms worst  color %d guess %d fix %d blocked %d\n", "random",
+           1000.0 * total / NUM_RANDOM, 1000.0 * worst, kinds[HINT_COLOR], kinds[HINT_GUESS],
+           kinds[HINT_FIX_CONFLICT], kinds[HINT_BLOCKED]);
+
+    freeGraph(g);
+    free(level);
+    return status;
+}
+
+
+// Colors saved by tabu search over the greedy bound on big levels, on one
+// thread and on numThreads
+int
+benchTabu(int numThreads, int numNodes, double budget)
+{
+    struct { const char *name; int planted; double degree; } cases[] = {
+        { "planted 4", 4, 6.0 },
+        { "planted 6", 6, 14.0 },
+        { "random", 0, 10.0 },
+    };
+
+    printf("%d nodes, %.1f s budget\n", numNodes, budget);
+    printf("%-10s %8s %6s %6s %6s %12s %12s %10s %10s\n", "graph", "edges", "clique", "greedy",
+           "planted", "1t colors", "Nt colors", "Nt iter/s", "restarts");
+    int status = 0;
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]) && status == 0; i++) {
+        Graph *level = NULL;
+        Graph g;
+        if(cases[i].planted > 0) {
+            GeneratorOptions opts;
+            defaultGeneratorOptions(&opts);
+            opts.numLevels = 1;
+            opts.minNodes = opts.maxNodes = numNodes;
+            opts.numColors = cases[i].planted;
+            opts.density = cases[i].degree / ((1.0 - 1.0 / cases[i].planted) * (numNodes - 1));
+            opts.layout = GEN_LAYOUT_CUBE;
+            opts.numThreads = 1;
+            level = generateLevels(&opts);
+            g = level[0];
+        } else {
+            g = randomSparseGraph(numNodes, (int)(cases[i].degree * numNodes / 2), 1100);
+        }
+        buildAdjacency(&g);
+
+        std::vector<int> greedy(numNodes), coloring(numNodes);
+        ChromaticResult chromatic = computeChromaticNumber(g, 0.0, &greedy[0], 1);
+
+        int colors[2];
+        TabuResult tabu[2];
+        int threadCounts[2] = { 1, numThreads };
+        for(int t = 0; t < 2; t++) {
+            coloring = greedy;
+            tabu[t] = improveColoringTabu(g, &coloring[0], chromatic.numColors, chromatic.lowerBound,
+                                          budget, threadCounts[t], 1);
+            colors[t] = tabu[t].numColors;
+            int used = 0;
+            for(int e = 0; e < g.numEdges; e++) {
+                int a = coloring[g.edges[e].from], b = coloring[g.edges[e].to];
+                if(a == b || a < 0 || a >= colors[t] || b < 0 || b >= colors[t]) {
+                    fprintf(stderr, "%s: edge %d-%d colored %d and %d\n", cases[i].name,
+                            g.edges[e].from, g.edges[e].to, a, b);
+                    status = 1;
+                    break;
+                }
+                if(a + 1 > used) used = a + 1;
+            }
+        }
+
+        char planted[16];
+        sprintf(planted, cases[i].planted > 0 ? "%d" : "-", cases[i].planted);
+        printf("%-10s %8d %6d %6d %6s %6d %4.1fs %6d %4.1fs %10.0f %10d\n", cases[i].name, g.numEdges,
+               chromatic.lowerBound, chromatic.numColors, planted, colors[0], tabu[0].seconds,
+               colors[1], tabu[1].seconds, tabu[1].seconds > 0.0 ? tabu[1].iterations / tabu[1].seconds : 0.0,
+               tabu[1].restarts);
+
+        if(level != NULL) {
+            freeGraph(&level[0]);
+            free(level);
+        } else {
+            freeGraph(&g);
+        }
+    }
+    return status;
+}
+
+
+// Bitset adjacency kernels, scalar and AVX2, against walking the CSR rows,
+// at a few densities
+int
+benchBitMatrix(int numNodes)
+{
+    const double densities[] = { 0.03, 0.1, 0.15, 0.2, 0.3, 0.6 };
+    const int NUM_PAIRS = 20000;
+    const int REPEATS = 5;
+
+    printf("%d nodes, AVX2 %s\n", numNodes, BitMatrixUseAvx2 ? "available" : "not available");
+    printf("%-8s %8s %4s | %-23s | %-23s | %-23s\n", "density", "edges", "mat",
+           "neighbor colors ns", "common neighbors ns", "independent set us");
+    printf("%-8s %8s %4s | %7s %7s %7s | %7s %7s %7s | %7s %7s %7s\n", "", "", "",
+           "csr", "scalar", "avx2", "csr", "scalar", "avx2", "csr", "scalar", "avx2");
+
+    int hasAvx2 = BitMatrixUseAvx2;
+    for(size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d++) {
+        Graph g = randomGraph(numNodes, densities[d], 1200 + (unsigned int)d);
+        buildAdjacencyMatrix(&g);
+
+        // a proper coloring, for independent color classes, with one node
+        // in eight left out so the masks vary
+        std::vector<int> coloring(numNodes);
+        greedyLargestFirst(g, &coloring[0]);
+        int numColors = 0;
+        for(int v = 0; v < numNodes; v++) {
+            if(coloring[v] + 1 > numColors) numColors = coloring[v] + 1;
+        }
+        if(numColors > 32) numColors = 32;
+        for(int v = 0; v < numNodes; v++) {
+            setNodeColor(&g, v, (v & 7) == 0 || coloring[v] >= numColors ? -1 : coloring[v]);
+        }
+        std::vector<uint64_t> classBits;
+        buildColorClassBits(&g, numColors, &classBits);
+
+        std::mt19937 rng(1300 + (unsigned int)d);
+        std::vector<int> pairs(2 * NUM_PAIRS);
+        for(size_t i = 0; i < pairs.size(); i++) pairs[i] = (int)(rng() % (unsigned int)numNodes);
+
+        // the CSR versions: walk the rows
+        std::vector<uint32_t> masks[3];
+        std::vector<int> common[3];
+        int independent[3] = {0};
+        double colorNs[3], commonNs[3], independentUs[3];
+        std::vector<int> mark(numNodes, 0);
+        int stamp = 0;
+        volatile uint32_t sink = 0;
+
+        for(int way = 0; way < 3; way++) {
+            if(way == 2 && !hasAvx2) {
+                colorNs[way] = commonNs[way] = independentUs[way] = 0.0;
+                masks[way] = masks[1];
+                common[way] = common[1];
+                independent[way] = independent[1];
+                continue;
+            }
+            BitMatrixUseAvx2 = way == 2;
+            masks[way].assign(numNodes, 0);
+            common[way].assign(NUM_PAIRS, 0);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(int r = 0; r < REPEATS; r++) {
+                for(int v = 0; v < numNodes; v++) {
+                    uint32_t mask = 0;
+                    if(way == 0) {
+                        for(int k = g.adjOffsets[v]; k < g.adjOffsets[v + 1]; k++) {
+                            int c = g.nodes[g.adjNeighbors[k]].color;
+                            if(c >= 0 && c < numColors) mask |= 1u << c;
+                        }
+                    } else {
+                        mask = matrixNeighborColors(&g, &classBits[0], numColors, v);
+                    }
+                    masks[way][v] = mask;
+                }
+            }
+            colorNs[way] = 1e9 * secondsSince(start) / ((double)REPEATS * numNodes);
+
+            start = std::chrono::steady_clock::now();
+            for(int r = 0; r < REPEATS; r++) {
+                for(int i = 0; i < NUM_PAIRS; i++) {
+                    int a = pairs[2 * i], b = pairs[2 * i + 1], count = 0;
+                    if(way == 0) {
+                        stamp++;
+                        for(int k = g.adjOffsets[a]; k < g.adjOffsets[a + 1]; k++) mark[g.adjNeighbors[k]] = stamp;
+                        for(int k = g.adjOffsets[b]; k < g.adjOffsets[b + 1]; k++) count += mark[g.adjNeighbors[k]] == stamp;
+                    } else {
+                        count = matrixCommonNeighbors(&g, a, b);
+                    }
+                    common[way][i] = count;
+                }
+            }
+            commonNs[way] = 1e9 * secondsSince(start) / ((double)REPEATS * NUM_PAIRS);
+
+            // every color class, then one with a neighbor pair added
+            start = std::chrono::steady_clock::now();
+            int numTests = 0;
+            for(int r = 0; r < REPEATS; r++) {
+                independent[way] = 0;
+                for(int c = 0; c <= numColors; c++) {
+                    std::vector<uint64_t> broken;
+                    const uint64_t *set = c < numColors ? &classBits[(size_t)c * g.adjMatrixWords] : NULL;
+                    if(set == NULL) {
+                        broken.assign(classBits.begin(), classBits.begin() + g.adjMatrixWords);
+                        int a = g.edges[0].from, b = g.edges[0].to;
+                        broken[a >> 6] |= 1ULL << (a & 63);
+                        broken[b >> 6] |= 1ULL << (b & 63);
+                        set = &broken[0];
+                    }
+                    int ok = 1;
+                    if(way == 0) {
+                        for(int v = 0; v < numNodes && ok; v++) {
+                            if(!((set[v >> 6] >> (v & 63)) & 1)) continue;
+                            for(int k = g.adjOffsets[v]; k < g.adjOffsets[v + 1]; k++) {
+                                int u = g.adjNeighbors[k];
+                                if((set[u >> 6] >> (u & 63)) & 1) {
+                                    ok = 0;
+                                    break;
+                                }
+                            }
+                        }
+                    } else {
+                        ok = matrixIsIndependent(&g, set);
+                    }
+                    independent[way] += ok;
+                    numTests++;
+                }
+            }
+            independentUs[way] = 1e6 * secondsSince(start) / numTests;
+            sink = sink + masks[way][0];
+        }
+        BitMatrixUseAvx2 = hasAvx2;
+
+        for(int way = 1; way < 3; way++) {
+            if(masks[way] != masks[0] || common[way] != common[0] || independent[way] != independent[0]) {
+                fprintf(stderr, "Density %.2f: %s kernels disagree with the CSR walk\n", densities[d],
+                        way == 1 ? "scalar" : "AVX2");
+                freeGraph(&g);
+                return 1;
+            }
+        }
+        if(independent[0] != numColors) {
+            fprintf(stderr, "Density %.2f: %d of %d classes independent\n", densities[d], independent[0], numColors);
+            freeGraph(&g);
+            return 1;
+        }
+
+        printf("%-8.2f %8d %4s | %7.1f %7.1f %7.1f | %7.1f %7.1f %7.1f | %7.2f %7.2f %7.2f\n",
+               densities[d], g.numEdges, wantsAdjacencyMatrix(&g) ? "yes" : "no",
+               colorNs[0], colorNs[1], colorNs[2], commonNs[0], commonNs[1], commonNs[2],
+               independentUs[0], independentUs[1], independentUs[2]);
+        freeGraph(&g);
+    }
+    return 0;
+}
+
+
+// Random moves with and without a journal, then undoing, redoing and
+// seeking through all of them; the board and its counters must match a
+// snapshot at every stop
+int
+benchJournal(long long numMoves)
+{
+    const int JOURNAL_NODES = 10000;
+    const int JOURNAL_EDGES = 15000;
+    const int NUM_SEEKS = 100;
+
+    Graph g = randomSparseGraph(JOURNAL_NODES, JOURNAL_EDGES, 1400);
+    buildAdjacency(&g);
+    g.optimalColors = MAX_COLORS;
+
+    std::mt19937 rng(29);
+    std::vector<int> moveNodes(1 << 16), moveColors(1 << 16);
+    for(size_t i = 0; i < moveNodes.size(); i++) {
+        moveNodes[i] = (int)(rng() % JOURNAL_NODES);
+        moveColors[i] = (int)(rng() % (MAX_COLORS + 1)) - 1;
+    }
+    size_t mask = moveNodes.size() - 1;
+
+    // the same moves, journaled or not; the middle board is kept to seek back to
+    MoveJournal journal;
+    clearMoveJournal(&journal);
+    GameState game;
+    double seconds[2];
+    std::vector<Node> middle, end;
+    for(int journaled = 0; journaled < 2; journaled++) {
+        initGame(&game, &g, 1);
+        game.journal = journaled ? &journal : NULL;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(long long m = 0; m < numMoves; m++) {
+            if(m == numMoves / 2 && journaled) {
+                seconds[1] = secondsSince(start);
+                middle.assign(g.nodes, g.nodes + g.numNodes);
+                start = std::chrono::steady_clock::now();
+            }
+            applyMove(&game, moveNodes[m & mask], moveColors[m & mask]);
+        }
+        seconds[journaled] = journaled ? seconds[1] + secondsSince(start) : secondsSince(start);
+    }
+    end.assign(g.nodes, g.nodes + g.numNodes);
+    int endConflicts = g.numConflicts, endUncolored = g.numUncolored;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long long undone = 0;
+    while(undoGameMove(&game) != MOVE_REJECTED) undone++;
+    double undoSeconds = secondsSince(start);
+    if(undone != numMoves || g.numConflicts != 0 || g.numUncolored != g.numNodes) {
+        fprintf(stderr, "Undoing %lld of %lld moves left %d conflicts, %d uncolored\n",
+                undone, numMoves, g.numConflicts, g.numUncolored);
+        return 1;
+    }
+
+    start = std::chrono::steady_clock::now();
+    long long redone = 0;
+    while(redoGameMove(&game) != MOVE_REJECTED) redone++;
+    double redoSeconds = secondsSince(start);
+    if(redone != numMoves || g.numConflicts != endConflicts || g.numUncolored != endUncolored ||
+       memcmp(g.nodes, &end[0], g.numNodes * sizeof(Node)) != 0) {
+        fprintf(stderr, "Redoing did not bring back the final board\n");
+        return 1;
+    }
+
+    // seeks: halfway, to the start, to the end, then anywhere
+    size_t stops[3] = { (size_t)(numMoves / 2), 0, (size_t)numMoves };
+    double seekSeconds[3];
+    for(int i = 0; i < 3; i++) {
+        start = std::chrono::steady_clock::now();
+        seekGameMove(&game, stops[i]);
+        seekSeconds[i] = secondsSince(start);
+        const Node *want = i == 0 ? &middle[0] : i == 2 ? &end[0] : NULL;
+        int ok = g.numConflicts == countConflicts(&g);
+        for(int v = 0; v < g.numNodes && ok; v++) {
+            ok = g.nodes[v].color == (want != NULL ? want[v].color : -1);
+        }
+        if(!ok) {
+            fprintf(stderr, "Seek to move %zu left the wrong board\n", stops[i]);
+            return 1;
+        }
+    }
+    start = std::chrono::steady_clock::now();
+    for(int i = 0; i < NUM_SEEKS; i++) {
+        seekGameMove(&game, (size_t)(rng() % (unsigned long long)(numMoves + 1)));
+    }
+    double randomSeekSeconds = secondsSince(start);
+    if(g.numConflicts != countConflicts(&g)) {
+        fprintf(stderr, "Conflict count drifted over seeks: %d kept, %d actual\n", g.numConflicts, countConflicts(&g));
+        return 1;
+    }
+
+    printf("%lld moves on %d nodes x %d edges, %.1f bytes per journaled move\n", numMoves, JOURNAL_NODES,
+           JOURNAL_EDGES, (double)journal.entries.capacity() * sizeof(uint32_t) / numMoves);
+    printf("moves, no journal  %8.2f M/s\n", numMoves / seconds[0] / 1e6);
+    printf("moves, journaled   %8.2f M/s\n", numMoves / seconds[1] / 1e6);
+    printf("undo               %8.2f M/s\n", numMoves / undoSeconds / 1e6);
+    printf("redo               %8.2f M/s\n", numMoves / redoSeconds / 1e6);
+    printf("seek half / start / end  %.3f / %.3f / %.3f ms, random %.3f ms each\n", 1000.0 * seekSeconds[0],
+           1000.0 * seekSeconds[1], 1000.0 * seekSeconds[2], 1000.0 * randomSeekSeconds / NUM_SEEKS);
+
+    freeGraph(&g);
+    return 0;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    if(argc < 2) {
+        fprintf(stderr, "Usage: %s chromatic [threads] | levelpack [file] | import [graph-file [pack-out]] | layout [threads] | bvh [nodes] | game [moves] | bots [threads [games [move-script]]] | transition [nodes] | morph [nodes] | generate [threads [levels [pack-out]]] | hint [nodes] | tabu [threads [nodes [seconds]]] | bitmatrix [nodes] | journal [moves]\n", argv[0]);
+        return 1;
+    }
+
+    if(strcmp(argv[1], "chromatic") == 0) {
+        int numThreads = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+        if(numThreads <= 0) numThreads = 1;
+        return benchChromatic(numThreads);
+    }
+
+    if(strcmp(argv[1], "levelpack") == 0) {
+        return benchLevelPack(argc > 2 ? argv[2] : "bench_levels.cglp");
+    }
+
+    if(strcmp(argv[1], "import") == 0) {
+        return benchImport(argc > 2 ? argv[2] : NULL, argc > 3 ? argv[3] : NULL);
+    }
+
+    if(strcmp(argv[1], "layout") == 0) {
+        return benchLayout(argc > 2 ? atoi(argv[2]) : 0);
+    }
+
+    if(strcmp(argv[1], "bvh") == 0) {
+        int numNodes = argc > 2 ? atoi(argv[2]) : 1000000;
+        return benchBvh(numNodes > 0 ? numNodes : 1);
+    }
+
+    if(strcmp(argv[1], "game") == 0) {
+        long long numMoves = argc > 2 ? atoll(argv[2]) : 50000000;
+        return benchGame(numMoves > 0 ? numMoves : 1);
+    }
+
+    if(strcmp(argv[1], "bots") == 0) {
+        int numThreads = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+        if(numThreads <= 0) numThreads = 1;
+        int numGames = argc > 3 ? atoi(argv[3]) : 1000;
+        return benchBots(numThreads, numGames > 0 ? numGames : 1, argc > 4 ? argv[4] : NULL);
+    }
+
+    if(strcmp(argv[1], "transition") == 0) {
+        int numNodes = argc > 2 ? atoi(argv[2]) : 100000;
+        return benchTransition(numNodes > 0 ? numNodes : 1);
+    }
+
+    if(strcmp(argv[1], "morph") == 0) {
+        int numNodes = argc > 2 ? atoi(argv[2]) : 10000;
+        return benchMorph(numNodes > 0 ? numNodes : 1);
+    }
+
+    if(strcmp(argv[1], "generate") == 0) {
+        int numThreads = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+        if(numThreads <= 0) numThreads = 1;
+        int numLevels = argc > 3 ? atoi(argv[3]) : 10000;
+        return benchGenerate(numThreads, numLevels > 0 ? numLevels : 1, argc > 4 ? argv[4] : "generated.cglp");
+    }
+
+    if(strcmp(argv[1], "hint") == 0) {
+        int numNodes = argc > 2 ? atoi(argv[2]) : 10000;
+        return benchHint(numNodes > 0 ? numNodes : 1);
+    }
+
+    if(strcmp(argv[1], "tabu") == 0) {
+        int numThreads = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+        if(numThreads <= 0) numThreads = 1;
+        int numNodes = argc > 3 ? atoi(argv[3]) : 50000;
+        double budget = argc > 4 ? atof(argv[4]) : 5.0;
+        return benchTabu(numThreads, numNodes > 100 ? numNodes : 100, budget > 0.0 ? budget : 0.1);
+    }
+
+    if(strcmp(argv[1], "bitmatrix") == 0) {
+        int numNodes = argc > 2 ? atoi(argv[2]) : 2000;
+        return benchBitMatrix(numNodes > 1 ? numNodes : 2);
+    }
+
+    if(strcmp(argv[1], "journal") == 0) {
+        long long numMoves = argc > 2 ? atoll(argv[2]) : 10000000;
+        return benchJournal(numMoves > 1 ? numMoves : 2);
+    }
+
+    fprintf(stderr, "Unknown benchmark '%s'\n", argv[1]);
+    return 1;
+}
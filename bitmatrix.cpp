@@ -0,0 +1,249 @@
+//	Bitset adjacency for dense levels
+//
+//	On a dense level a neighbor row is cheaper as n bits than as a list of
+//	ints: buildAdjacencyMatrix( ) packs one row of bits per node into
+//	Graph::adjMatrix next to the CSR index.  wantsAdjacencyMatrix( ) decides
+//	at load time; a level gets the matrix when at least BITMATRIX_MIN_DENSITY
+//	of its node pairs are edges and it has between BITMATRIX_MIN_NODES and
+//	BITMATRIX_MAX_NODES nodes.
+//
+//	Rows are padded to whole 256-bit blocks, so the kernels never handle a
+//	tail.  Each kernel has a scalar 64-bit version and an AVX2 version; the
+//	AVX2 one is compiled with a target attribute and picked at run time when
+//	the processor has it, so the default build still runs anywhere.
+//		matrixNeighborColors	which colors a node's neighbors use
+//		matrixCommonNeighbors	how many neighbors two nodes share
+//		matrixIsIndependent	whether no two nodes of a set are neighbors
+//
+//	Color classes are passed as bitsets of the same row width, one per
+//	color; buildColorClassBits( ) makes them from the node colors.
+//
+//	Needs graph.cpp to be included first.
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BITMATRIX_HAVE_AVX2 1
+#endif
+
+// smallest level that gets a matrix: below this a neighbor list is a few
+// ints and the rows would be mostly padding
+const int BITMATRIX_MIN_NODES = 64;
+
+// biggest level that gets a matrix: 8 MB of rows
+const int BITMATRIX_MAX_NODES = 8192;
+
+// fewest edges, as a fraction of all node pairs, for a level to get a matrix.
+// matrixNeighborColors( ) costs the same at any density while a CSR row walk
+// grows with the degree; `bench bitmatrix` puts the crossover between 0.10
+// and 0.15 (1000 nodes: 0.10 CSR 260 ns vs matrix 385 ns, 0.15 CSR 540 ns
+// vs 350 ns)
+const double BITMATRIX_MIN_DENSITY = 0.12;
+
+// words per row come in blocks of this many (256 bits)
+const int BITMATRIX_BLOCK_WORDS = 4;
+
+#ifdef BITMATRIX_HAVE_AVX2
+static int
+processorHasAvx2()
+{
+    __builtin_cpu_init();       // static initializers may run before the library's own
+    return __builtin_cpu_supports("avx2") ? 1 : 0;
+}
+
+// 1 to use the AVX2 kernels; set at startup when the processor has them
+int BitMatrixUseAvx2 = processorHasAvx2();
+#else
+int BitMatrixUseAvx2 = 0;
+#endif
+
+
+// 1 if g is dense enough for the matrix kernels to beat walking its CSR rows
+int
+wantsAdjacencyMatrix(const Graph *g)
+{
+    if(g->numNodes < BITMATRIX_MIN_NODES || g->numNodes > BITMATRIX_MAX_NODES) return 0;
+    double pairs = 0.5 * (double)g->numNodes * (g->numNodes - 1);
+    return (double)g->numEdges >= BITMATRIX_MIN_DENSITY * pairs;
+}
+
+int
+matrixRowWords(int numNodes)
+{
+    int words = (numNodes + 63) / 64;
+    return (words + BITMATRIX_BLOCK_WORDS - 1) / BITMATRIX_BLOCK_WORDS * BITMATRIX_BLOCK_WORDS;
+}
+
+// Build (or rebuild) g->adjMatrix from the edge array
+void
+buildAdjacencyMatrix(Graph *g)
+{
+    free(g->adjMatrix);
+    g->adjMatrixWords = matrixRowWords(g->numNodes);
+    size_t numWords = (size_t)g->numNodes * g->adjMatrixWords;
+    g->adjMatrix = (uint64_t *)calloc(numWords > 0 ? numWords : 1, sizeof(uint64_t));
+    if(!g->adjMatrix) {
+        fprintf(stderr, "Memory allocation failed for adjacency matrix\n");
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 0; i < g->numEdges; i++) {
+        int a = g->edges[i].from, b = g->edges[i].to;
+        g->adjMatrix[(size_t)a * g->adjMatrixWords + (b >> 6)] |= 1ULL << (b & 63);
+        g->adjMatrix[(size_t)b * g->adjMatrixWords + (a >> 6)] |= 1ULL << (a & 63);
+    }
+}
+
+static inline const uint64_t *
+matrixRow(const Graph *g, int v)
+{
+    return g->adjMatrix + (size_t)v * g->adjMatrixWords;
+}
+
+// One bitset per color, numColors * adjMatrixWords words, from the node colors
+void
+buildColorClassBits(const Graph *g, int numColors, std::vector<uint64_t> *classBits)
+{
+    classBits->assign((size_t)numColors * g->adjMatrixWords, 0);
+    for(int v = 0; v < g->numNodes; v++) {
+        int c = g->nodes[v].color;
+        if(c >= 0 && c < numColors) {
+            (*classBits)[(size_t)c * g->adjMatrixWords + (v >> 6)] |= 1ULL << (v & 63);
+        }
+    }
+}
+
+
+static uint32_t
+neighborColorsScalar(const Graph *g, const uint64_t *classBits, int numColors, int v)
+{
+    const uint64_t *row = matrixRow(g, v);
+    uint32_t mask = 0;
+    for(int c = 0; c < numColors; c++) {
+        const uint64_t *cls = classBits + (size_t)c * g->adjMatrixWords;
+        for(int w = 0; w < g->adjMatrixWords; w++) {
+            if(row[w] & cls[w]) {
+                mask |= 1u << c;
+                break;
+            }
+        }
+    }
+    return mask;
+}
+
+static int
+commonNeighborsScalar(const Graph *g, int a, int b)
+{
+    const uint64_t *ra = matrixRow(g, a), *rb = matrixRow(g, b);
+    int count = 0;
+    for(int w = 0; w < g->adjMatrixWords; w++) {
+        count += __builtin_popcountll(ra[w] & rb[w]);
+    }
+    return count;
+}
+
+static int
+isIndependentScalar(const Graph *g, const uint64_t *setBits)
+{
+    for(int w = 0; w < g->adjMatrixWords; w++) {
+        for(uint64_t bits = setBits[w]; bits != 0; bits &= bits - 1) {
+            const uint64_t *row = matrixRow(g, w * 64 + __builtin_ctzll(bits));
+            for(int x = 0; x < g->adjMatrixWords; x++) {
+                if(row[x] & setBits[x]) return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+
+#ifdef BITMATRIX_HAVE_AVX2
+__attribute__((target("avx2"))) static uint32_t
+neighborColorsAvx2(const Graph *g, const uint64_t *classBits, int numColors, int v)
+{
+    const uint64_t *row = matrixRow(g, v);
+    uint32_t mask = 0;
+    for(int c = 0; c < numColors; c++) {
+        const uint64_t *cls = classBits + (size_t)c * g->adjMatrixWords;
+        for(int w = 0; w < g->adjMatrixWords; w += BITMATRIX_BLOCK_WORDS) {
+            __m256i r = _mm256_loadu_si256((const __m256i *)(row + w));
+            __m256i k = _mm256_loadu_si256((const __m256i *)(cls + w));
+            if(!_mm256_testz_si256(r, k)) {
+                mask |= 1u << c;
+                break;
+            }
+        }
+    }
+    return mask;
+}
+
+// Popcount by nibble lookup (Mula): pshufb counts each nibble, psadbw sums
+// the bytes of each 64-bit lane
+__attribute__((target("avx2"))) static int
+commonNeighborsAvx2(const Graph *g, int a, int b)
+{
+    const uint64_t *ra = matrixRow(g, a), *rb = matrixRow(g, b);
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowNibble = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    for(int w = 0; w < g->adjMatrixWords; w += BITMATRIX_BLOCK_WORDS) {
+        __m256i x = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(ra + w)),
+                                     _mm256_loadu_si256((const __m256i *)(rb + w)));
+        __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, lowNibble));
+        __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), lowNibble));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, total);
+    return (int)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx2"))) static int
+isIndependentAvx2(const Graph *g, const uint64_t *setBits)
+{
+    for(int w = 0; w < g->adjMatrixWords; w++) {
+        for(uint64_t bits = setBits[w]; bits != 0; bits &= bits - 1) {
+            const uint64_t *row = matrixRow(g, w * 64 + __builtin_ctzll(bits));
+            for(int x = 0; x < g->adjMatrixWords; x += BITMATRIX_BLOCK_WORDS) {
+                if(!_mm256_testz_si256(_mm256_loadu_si256((const __m256i *)(row + x)),
+                                       _mm256_loadu_si256((const __m256i *)(setBits + x)))) return 0;
+            }
+        }
+    }
+    return 1;
+}
+#endif
+
+
+// Bit c set if some neighbor of v is in color class c (classBits from
+// buildColorClassBits( ), numColors at most 32)
+uint32_t
+matrixNeighborColors(const Graph *g, const uint64_t *classBits, int numColors, int v)
+{
+#ifdef BITMATRIX_HAVE_AVX2
+    if(BitMatrixUseAvx2) return neighborColorsAvx2(g, classBits, numColors, v);
+#endif
+    return neighborColorsScalar(g, classBits, numColors, v);
+}
+
+int
+matrixCommonNeighbors(const Graph *g, int a, int b)
+{
+#ifdef BITMATRIX_HAVE_AVX2
+    if(BitMatrixUseAvx2) return commonNeighborsAvx2(g, a, b);
+#endif
+    return commonNeighborsScalar(g, a, b);
+}
+
+// 1 if no two nodes of setBits (adjMatrixWords words) are neighbors
+int
+matrixIsIndependent(const Graph *g, const uint64_t *setBits)
+{
+#ifdef BITMATRIX_HAVE_AVX2
+    if(BitMatrixUseAvx2) return isIndependentAvx2(g, setBits);
+#endif
+    return isIndependentScalar(g, setBits);
+}
@@ -0,0 +1,274 @@
+//	Automated players for the game core
+//
+//	runBots( ) plays many independent games over the same levels at once,
+//	spread over worker threads.  Every move goes through applyMove( ) and is
+//	checked the way provideFeedback( ) checks a key press, so the scoring and
+//	validation code sees the same traffic it would from real players.
+//
+//	A game's moves come from one of:
+//		BOT_RANDOM	random (node, color) pairs, seeded per game
+//		BOT_GREEDY	each node in turn gets the lowest color its neighbors
+//				leave free; solves any level that needs few colors
+//		BOT_REPLAY	a recorded move script, the same one for every game
+//
+//	Levels are shared read-only; each worker owns one copy of the node arrays
+//	and reuses it for every game it plays, so nothing is allocated once the
+//	games start.  Move scripts are text files with one "node color" pair per
+//	line; '#' starts a comment.
+//
+//	Needs graph.cpp, journal.cpp and gamecore.cpp to be included first.
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+typedef struct BotMove {
+    int node;
+    int color;              // -1 clears the node
+} BotMove;
+
+enum BotKind {
+    BOT_RANDOM,
+    BOT_GREEDY,
+    BOT_REPLAY
+};
+
+typedef struct BotOptions {
+    BotKind kind;
+    int numGames;
+    int numThreads;                 // 0 means one per core
+    long long maxMovesPerGame;      // a game stops here if it is not finished
+    unsigned int seed;              // BOT_RANDOM: game g uses seed + g
+    const BotMove *script;          // BOT_REPLAY
+    long long scriptLength;
+} BotOptions;
+
+typedef struct BotStats {
+    long long games;
+    long long gamesCompleted;
+    long long levelsSolved;
+    long long moves;                // applied moves
+    long long rejectedMoves;
+    long long conflictingMoves;     // moves that left the node sharing a color with a neighbor
+    long long totalScore;
+    double seconds;
+} BotStats;
+
+
+// Read a move script, replacing moves.  Returns 0 if the file cannot be read
+// or has a line that is not "node color".
+int
+loadMoveScript(const char *path, std::vector<BotMove> *moves)
+{
+    FILE *fp = fopen(path, "r");
+    if(fp == NULL) {
+        fprintf(stderr, "Cannot open move script '%s'\n", path);
+        return 0;
+    }
+
+    moves->clear();
+    char line[256];
+    int lineNumber = 0;
+    while(fgets(line, sizeof(line), fp) != NULL) {
+        lineNumber++;
+        char *hash = strchr(line, '#');
+        if(hash != NULL) *hash = '\0';
+
+        BotMove m;
+        char extra;
+        int fields = sscanf(line, "%d %d %c", &m.node, &m.color, &extra);
+        if(fields == EOF) {
+            continue;       // blank or comment
+        }
+        if(fields != 2) {
+            fprintf(stderr, "%s:%d: expected \"node color\"\n", path, lineNumber);
+            fclose(fp);
+            return 0;
+        }
+        moves->push_back(m);
+    }
+    fclose(fp);
+    return 1;
+}
+
+int
+saveMoveScript(const char *path, const BotMove *moves, long long numMoves)
+{
+    FILE *fp = fopen(path, "w");
+    if(fp == NULL) {
+        fprintf(stderr, "Cannot create move script '%s'\n", path);
+        return 0;
+    }
+    fprintf(fp, "# node color\n");
+    for(long long i = 0; i < numMoves; i++) {
+        fprintf(fp, "%d %d\n", moves[i].node, moves[i].color);
+    }
+    return fclose(fp) == 0;
+}
+
+
+// One worker's private copy of the levels: the same edges and neighbor
+// index, but its own node colors and validity counters
+typedef struct BotBoard {
+    std::vector<Graph> levels;
+    std::vector<Node> nodes;
+} BotBoard;
+
+static void
+makeBotBoard(BotBoard *board, const Graph *levels, int numLevels)
+{
+    size_t totalNodes = 0;
+    for(int l = 0; l < numLevels; l++) {
+        totalNodes += levels[l].numNodes;
+    }
+    board->nodes.resize(totalNodes > 0 ? totalNodes : 1);
+    board->levels.assign(levels, levels + numLevels);
+
+    size_t at = 0;
+    for(int l = 0; l < numLevels; l++) {
+        memcpy(&board->nodes[at], levels[l].nodes, levels[l].numNodes * sizeof(Node));
+        board->levels[l].nodes = &board->nodes[at];
+        at += levels[l].numNodes;
+    }
+}
+
+// Lowest color none of node's neighbors has, or the last color if all are taken
+static int
+greedyColor(const Graph *g, int node)
+{
+    int used = 0;
+    for(int k = g->adjOffsets[node]; k < g->adjOffsets[node + 1]; k++) {
+        int c = g->nodes[g->adjNeighbors[k]].color;
+        if(c >= 0) used |= 1 << c;
+    }
+    int color = 0;
+    while(color < MAX_COLORS - 1 && (used & (1 << color))) color++;
+    return color;
+}
+
+// Play game number gameIndex to the end on board, adding to stats
+static void
+playBotGame(BotBoard *board, const BotOptions *opts, int gameIndex, BotStats *stats)
+{
+    GameState game;
+    initGame(&game, &board->levels[0], (int)board->levels.size());
+
+    std::mt19937 rng(opts->seed + (unsigned int)gameIndex);
+    std::uniform_int_distribution<int> pickColor(-1, MAX_COLORS - 1);
+    int greedyNext = 0;
+
+    for(long long m = 0; m < opts->maxMovesPerGame && !game.gameCompleted; m++) {
+        Graph *g = currentGraph(&game);
+        int node, color;
+        if(opts->kind == BOT_REPLAY) {
+            if(m >= opts->scriptLength) break;
+            node = opts->script[m].node;
+            color = opts->script[m].color;
+        } else if(opts->kind == BOT_GREEDY) {
+            if(greedyNext >= g->numNodes) break;    // a level greedy could not solve
+            node = greedyNext++;
+            color = greedyColor(g, node);
+        } else {
+            if(g->numNodes == 0) break;
+            node = (int)(rng() % (unsigned int)g->numNodes);
+            color = pickColor(rng);
+        }
+
+        MoveResult result = applyMove(&game, node, color);
+        if(result == MOVE_REJECTED) {
+            stats->rejectedMoves++;
+            continue;
+        }
+        stats->moves++;
+        if(findConflictingNeighbor(*g, node) != -1) {
+            stats->conflictingMoves++;
+        }
+        if(result == MOVE_SOLVED_LEVEL || result == MOVE_SOLVED_GAME) {
+            stats->levelsSolved++;
+            advanceLevel(&game);
+            greedyNext = 0;
+        }
+    }
+
+    stats->games++;
+    if(game.gameCompleted) stats->gamesCompleted++;
+    stats->totalScore += game.score;
+}
+
+typedef struct BotShared {
+    const Graph *levels;
+    int numLevels;
+    const BotOptions *opts;
+    std::vector<BotBoard> boards;       // one per worker, made before the clock starts
+    std::atomic<int> nextGame;
+    std::mutex statsLock;
+    BotStats stats;
+} BotShared;
+
+static void
+botWorker(BotShared *sh, int worker)
+{
+    BotStats mine;
+    memset(&mine, 0, sizeof(mine));
+    for(;;) {
+        int g = sh->nextGame++;
+        if(g >= sh->opts->numGames) break;
+        playBotGame(&sh->boards[worker], sh->opts, g, &mine);
+    }
+
+    std::lock_guard<std::mutex> lock(sh->statsLock);
+    sh->stats.games += mine.games;
+    sh->stats.gamesCompleted += mine.gamesCompleted;
+    sh->stats.levelsSolved += mine.levelsSolved;
+    sh->stats.moves += mine.moves;
+    sh->stats.rejectedMoves += mine.rejectedMoves;
+    sh->stats.conflictingMoves += mine.conflictingMoves;
+    sh->stats.totalScore += mine.totalScore;
+}
+
+
+// Play opts->numGames games over levels[0 .. numLevels-1].  The levels must
+// have their neighbor index built; their own colors are not touched.
+BotStats
+runBots(const Graph *levels, int numLevels, const BotOptions *opts)
+{
+    BotShared sh;
+    sh.levels = levels;
+    sh.numLevels = numLevels;
+    sh.opts = opts;
+    sh.nextGame = 0;
+    memset(&sh.stats, 0, sizeof(sh.stats));
+    if(numLevels <= 0 || opts->numGames <= 0) {
+        return sh.stats;
+    }
+
+    int numThreads = opts->numThreads;
+    if(numThreads <= 0) {
+        numThreads = (int)std::thread::hardware_concurrency();
+        if(numThreads <= 0) numThreads = 1;
+    }
+    if(numThreads > opts->numGames) numThreads = opts->numGames;
+
+    sh.boards.resize(numThreads);
+    for(int t = 0; t < numThreads; t++) {
+        makeBotBoard(&sh.boards[t], levels, numLevels);
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int t = 1; t < numThreads; t++) {
+        threads.push_back(std::thread(botWorker, &sh, t));
+    }
+    botWorker(&sh, 0);
+    for(size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    sh.stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return sh.stats;
+}
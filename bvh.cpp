@@ -0,0 +1,422 @@
+//	Bounding-volume hierarchy over node spheres
+//
+//	One tree answers the "which nodes are near here" questions: the nearest
+//	sphere along a ray (picking), the node nearest a point (matching nodes
+//	between levels), every sphere within a distance of a point,
+//	every sphere touching a box, and every sphere inside the view frustum
+//	(culling).  The tree is built once per level by median splits on the
+//	longest axis.  When the nodes move (the transition between levels) it is
+//	refit instead of rebuilt: the same hierarchy, with every box recomputed
+//	bottom-up from the new positions in one pass.
+//
+//	Tree nodes are stored in depth-first order with the left child right after
+//	its parent, so a reverse sweep visits children before parents.
+//
+//	No OpenGL here, so the command-line tools can use it too.
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <vector>
+
+// spheres per leaf
+const int BVH_LEAF_SIZE = 4;
+
+typedef struct BvhNode {
+    float lo[3], hi[3];         // bounds of every sphere below this node
+    int right;                  // index of the right child; the left child is this + 1
+    int first, count;           // leaves: spheres order[first .. first+count-1]; count == 0 inside
+} BvhNode;
+
+typedef struct NodeBvh {
+    float radius;               // every sphere has this radius
+    int numItems;
+    std::vector<BvhNode> nodes;
+    std::vector<int> order;     // item indices, grouped by leaf
+    std::vector<float> positions;   // xyz of every item, as of the last build or refit
+} NodeBvh;
+
+// an item and its position, moved around together while building
+typedef struct BvhBuildItem {
+    float p[3];
+    int item;
+} BvhBuildItem;
+
+
+static void
+bvhLeafBounds(NodeBvh *bvh, BvhNode *node)
+{
+    for(int a = 0; a < 3; a++) {
+        node->lo[a] = FLT_MAX;
+        node->hi[a] = -FLT_MAX;
+    }
+    for(int k = node->first; k < node->first + node->count; k++) {
+        const float *p = &bvh->positions[3 * (size_t)bvh->order[k]];
+        for(int a = 0; a < 3; a++) {
+            node->lo[a] = p[a] - bvh->radius < node->lo[a] ? p[a] - bvh->radius : node->lo[a];
+            node->hi[a] = p[a] + bvh->radius > node->hi[a] ? p[a] + bvh->radius : node->hi[a];
+        }
+    }
+}
+
+
+static void
+bvhMergeBounds(NodeBvh *bvh, int index)
+{
+    BvhNode *node = &bvh->nodes[index];
+    const BvhNode *left = &bvh->nodes[index + 1];
+    const BvhNode *right = &bvh->nodes[node->right];
+    for(int a = 0; a < 3; a++) {
+        node->lo[a] = left->lo[a] < right->lo[a] ? left->lo[a] : right->lo[a];
+        node->hi[a] = left->hi[a] > right->hi[a] ? left->hi[a] : right->hi[a];
+    }
+}
+
+
+// Build the subtree over items[first .. first+count-1]; returns its node index
+static int
+bvhBuildRange(NodeBvh *bvh, BvhBuildItem *items, int first, int count)
+{
+    int index = (int)bvh->nodes.size();
+    bvh->nodes.push_back(BvhNode());
+    BvhNode *node = &bvh->nodes[index];
+    node->first = first;
+    node->count = count;
+    node->right = -1;
+    if(count <= BVH_LEAF_SIZE) {
+        for(int k = first; k < first + count; k++) bvh->order[k] = items[k].item;
+        bvhLeafBounds(bvh, node);
+        return index;
+    }
+    node->count = 0;
+
+    // split at the median of the axis along which the centers spread the most
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for(int k = first; k < first + count; k++) {
+        for(int a = 0; a < 3; a++) {
+            lo[a] = items[k].p[a] < lo[a] ? items[k].p[a] : lo[a];
+            hi[a] = items[k].p[a] > hi[a] ? items[k].p[a] : hi[a];
+        }
+    }
+    float extent[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+    int axis = extent[0] > extent[1] ? (extent[0] > extent[2] ? 0 : 2) : (extent[1] > extent[2] ? 1 : 2);
+    int half = count / 2;
+    std::nth_element(items + first, items + first + half, items + first + count,
+                     [axis](const BvhBuildItem &a, const BvhBuildItem &b) { return a.p[axis] < b.p[axis]; });
+
+    bvhBuildRange(bvh, items, first, half);
+    int right = bvhBuildRange(bvh, items, first + half, count - half);
+    bvh->nodes[index].right = right;
+    bvhMergeBounds(bvh, index);
+    return index;
+}
+
+
+// Build the tree over n spheres of the given radius; positions are xyz triples
+void
+buildNodeBvh(NodeBvh *bvh, const float *positions, int n, float radius)
+{
+    bvh->radius = radius;
+    bvh->numItems = n;
+    bvh->positions.assign(positions, positions + 3 * (size_t)n);
+    bvh->order.resize(n);
+    bvh->nodes.clear();
+    if(n > 0) {
+        // the positions travel with the items so every pass reads memory in order
+        std::vector<BvhBuildItem> items(n);
+        for(int i = 0; i < n; i++) {
+            items[i].p[0] = positions[3 * (size_t)i];
+            items[i].p[1] = positions[3 * (size_t)i + 1];
+            items[i].p[2] = positions[3 * (size_t)i + 2];
+            items[i].item = i;
+        }
+        bvh->nodes.reserve(2 * (n / BVH_LEAF_SIZE + 1));
+        bvhBuildRange(bvh, &items[0], 0, n);
+    }
+}
+
+
+// Move the spheres to new positions (same count, same order) and recompute
+// every box without changing the tree's shape
+void
+refitNodeBvh(NodeBvh *bvh, const float *positions)
+{
+    bvh->positions.assign(positions, positions + 3 * (size_t)bvh->numItems);
+    for(int i = (int)bvh->nodes.size() - 1; i >= 0; i--) {
+        if(bvh->nodes[i].count > 0) bvhLeafBounds(bvh, &bvh->nodes[i]);
+        else bvhMergeBounds(bvh, i);
+    }
+}
+
+
+// Ray parameter where origin + t * dir first meets the sphere around center, or -1
+static inline float
+raySphere(const float origin[3], const float dir[3], const float *center, float radius)
+{
+    float oc[3] = { origin[0] - center[0], origin[1] - center[1], origin[2] - center[2] };
+    float a = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+    float b = dir[0] * oc[0] + dir[1] * oc[1] + dir[2] * oc[2];
+    float c = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] - radius * radius;
+    float disc = b * b - a * c;
+    if(disc < 0.f) return -1.f;
+    float root = sqrtf(disc);
+    float t = (-b - root) / a;
+    if(t < 0.f) t = (-b + root) / a;    // ray starts inside the sphere
+    return t;
+}
+
+
+// Where the ray enters the box, or FLT_MAX if it misses (or only hits beyond tMax)
+static inline float
+rayBox(const float origin[3], const float invDir[3], const BvhNode *node, float tMax)
+{
+    float tEnter = 0.f, tExit = tMax;
+    for(int a = 0; a < 3; a++) {
+        float t0 = (node->lo[a] - origin[a]) * invDir[a];
+        float t1 = (node->hi[a] - origin[a]) * invDir[a];
+        if(t0 > t1) { float t = t0; t0 = t1; t1 = t; }
+        if(t0 > tEnter) tEnter = t0;
+        if(t1 < tExit) tExit = t1;
+        if(tEnter > tExit) return FLT_MAX;
+    }
+    return tEnter;
+}
+
+
+// Nearest item whose sphere the ray origin + t * dir (t >= 0) hits, or -1.
+// dir need not be normalized.
+int
+bvhRayNearest(const NodeBvh *bvh, const float origin[3], const float dir[3])
+{
+    if(bvh->nodes.empty()) return -1;
+
+    float invDir[3];
+    for(int a = 0; a < 3; a++) {
+        invDir[a] = dir[a] != 0.f ? 1.f / dir[a] : (dir[a] >= 0.f ? FLT_MAX : -FLT_MAX);
+    }
+
+    int best = -1;
+    float bestT = FLT_MAX;
+    int stack[64];
+    int depth = 0;
+    if(rayBox(origin, invDir, &bvh->nodes[0], bestT) == FLT_MAX) return -1;
+    stack[depth++] = 0;
+    while(depth > 0) {
+        const BvhNode *node = &bvh->nodes[stack[--depth]];
+        if(node->count > 0) {
+            for(int k = node->first; k < node->first + node->count; k++) {
+                int i = bvh->order[k];
+                float t = raySphere(origin, dir, &bvh->positions[3 * (size_t)i], bvh->radius);
+                if(t >= 0.f && (t < bestT || (t == bestT && i < best))) {
+                    bestT = t;
+                    best = i;
+                }
+            }
+            continue;
+        }
+
+        // push the farther child first so the nearer one is searched first
+        int left = (int)(node - &bvh->nodes[0]) + 1;
+        int right = node->right;
+        float tLeft = rayBox(origin, invDir, &bvh->nodes[left], bestT);
+        float tRight = rayBox(origin, invDir, &bvh->nodes[right], bestT);
+        if(tLeft > tRight) {
+            std::swap(left, right);
+            std::swap(tLeft, tRight);
+        }
+        if(tRight != FLT_MAX) stack[depth++] = right;
+        if(tLeft != FLT_MAX) stack[depth++] = left;
+    }
+    return best;
+}
+
+
+// Squared distance from point to the nearest place a center inside node can be
+static inline float
+bvhCenterDistance2(const NodeBvh *bvh, const BvhNode *node, const float point[3])
+{
+    float d2 = 0.f;
+    for(int a = 0; a < 3; a++) {
+        float lo = node->lo[a] + bvh->radius, hi = node->hi[a] - bvh->radius;
+        float d = point[a] < lo ? lo - point[a] : point[a] > hi ? point[a] - hi : 0.f;
+        d2 += d * d;
+    }
+    return d2;
+}
+
+
+// Item whose center is nearest to point, skipping items with skip[item] != 0
+// (skip may be NULL).  Returns -1 if every item is skipped.
+int
+bvhNearestCenter(const NodeBvh *bvh, const float point[3], const char *skip)
+{
+    if(bvh->nodes.empty()) return -1;
+
+    int best = -1;
+    float bestD2 = FLT_MAX;
+    int stack[64];
+    float stackD2[64];
+    int depth = 0;
+    stack[depth] = 0;
+    stackD2[depth++] = 0.f;
+    while(depth > 0) {
+        depth--;
+        if(stackD2[depth] > bestD2) continue;
+        const BvhNode *node = &bvh->nodes[stack[depth]];
+
+        if(node->count > 0) {
+            for(int k = node->first; k < node->first + node->count; k++) {
+                int i = bvh->order[k];
+                if(skip != NULL && skip[i]) continue;
+                const float *p = &bvh->positions[3 * (size_t)i];
+                float dx = p[0] - point[0], dy = p[1] - point[1], dz = p[2] - point[2];
+                float d2 = dx * dx + dy * dy + dz * dz;
+                if(d2 < bestD2 || (d2 == bestD2 && i < best)) {
+                    bestD2 = d2;
+                    best = i;
+                }
+            }
+            continue;
+        }
+
+        // push the farther child first so the nearer one is searched first
+        int left = stack[depth] + 1;
+        int right = node->right;
+        float dLeft = bvhCenterDistance2(bvh, &bvh->nodes[left], point);
+        float dRight = bvhCenterDistance2(bvh, &bvh->nodes[right], point);
+        if(dLeft > dRight) {
+            std::swap(left, right);
+            std::swap(dLeft, dRight);
+        }
+        stack[depth] = right;
+        stackD2[depth++] = dRight;
+        stack[depth] = left;
+        stackD2[depth++] = dLeft;
+    }
+    return best;
+}
+
+
+// Append to out every item whose sphere comes within distance of center
+void
+bvhQuerySphere(const NodeBvh *bvh, const float center[3], float distance, std::vector<int> *out)
+{
+    if(bvh->nodes.empty()) return;
+
+    float reach = distance + bvh->radius;
+    int stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while(depth > 0) {
+        int index = stack[--depth];
+        const BvhNode *node = &bvh->nodes[index];
+
+        // squared distance from center to the box
+        float d2 = 0.f;
+        for(int a = 0; a < 3; a++) {
+            float d = center[a] < node->lo[a] ? node->lo[a] - center[a] :
+                      center[a] > node->hi[a] ? center[a] - node->hi[a] : 0.f;
+            d2 += d * d;
+        }
+        if(d2 > distance * distance) continue;
+
+        if(node->count > 0) {
+            for(int k = node->first; k < node->first + node->count; k++) {
+                const float *p = &bvh->positions[3 * (size_t)bvh->order[k]];
+                float dx = p[0] - center[0], dy = p[1] - center[1], dz = p[2] - center[2];
+                if(dx * dx + dy * dy + dz * dz <= reach * reach) out->push_back(bvh->order[k]);
+            }
+        } else {
+            stack[depth++] = node->right;
+            stack[depth++] = index + 1;
+        }
+    }
+}
+
+
+// Append to out every item whose sphere's bounds overlap the box lo..hi
+void
+bvhQueryBox(const NodeBvh *bvh, const float lo[3], const float hi[3], std::vector<int> *out)
+{
+    if(bvh->nodes.empty()) return;
+
+    float r = bvh->radius;
+    int stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while(depth > 0) {
+        int index = stack[--depth];
+        const BvhNode *node = &bvh->nodes[index];
+        if(node->lo[0] > hi[0] || node->hi[0] < lo[0] ||
+           node->lo[1] > hi[1] || node->hi[1] < lo[1] ||
+           node->lo[2] > hi[2] || node->hi[2] < lo[2]) continue;
+
+        if(node->count > 0) {
+            for(int k = node->first; k < node->first + node->count; k++) {
+                const float *p = &bvh->positions[3 * (size_t)bvh->order[k]];
+                if(p[0] + r >= lo[0] && p[0] - r <= hi[0] &&
+                   p[1] + r >= lo[1] && p[1] - r <= hi[1] &&
+                   p[2] + r >= lo[2] && p[2] - r <= hi[2]) out->push_back(bvh->order[k]);
+            }
+        } else {
+            stack[depth++] = node->right;
+            stack[depth++] = index + 1;
+        }
+    }
+}
+
+
+// Append to out every item whose sphere is at least partly inside all the
+// planes (a, b, c, d), where inside means a*x + b*y + c*z + d >= 0.
+// Six planes make a view frustum; subtrees entirely inside are copied
+// out without testing their spheres.
+void
+bvhQueryFrustum(const NodeBvh *bvh, const float planes[][4], int numPlanes, std::vector<int> *out)
+{
+    if(bvh->nodes.empty()) return;
+
+    float r = bvh->radius;
+    int stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while(depth > 0) {
+        int index = stack[--depth];
+        const BvhNode *node = &bvh->nodes[index];
+
+        bool outside = false, inside = true;
+        for(int k = 0; k < numPlanes && !outside; k++) {
+            const float *pl = planes[k];
+            // the box corners farthest along and against the plane normal
+            float far = pl[3], near = pl[3];
+            for(int a = 0; a < 3; a++) {
+                far += pl[a] * (pl[a] >= 0.f ? node->hi[a] : node->lo[a]);
+                near += pl[a] * (pl[a] >= 0.f ? node->lo[a] : node->hi[a]);
+            }
+            if(far < 0.f) outside = true;
+            else if(near < 0.f) inside = false;
+        }
+        if(outside) continue;
+
+        if(inside) {
+            // every item of the subtree: from its leftmost to its rightmost leaf
+            const BvhNode *last = node;
+            while(last->count == 0) last = &bvh->nodes[last->right];
+            out->insert(out->end(), bvh->order.begin() + node->first, bvh->order.begin() + last->first + last->count);
+        } else if(node->count > 0) {
+            for(int k = node->first; k < node->first + node->count; k++) {
+                const float *p = &bvh->positions[3 * (size_t)bvh->order[k]];
+                bool visible = true;
+                for(int j = 0; j < numPlanes && visible; j++) {
+                    const float *pl = planes[j];
+                    float length = sqrtf(pl[0] * pl[0] + pl[1] * pl[1] + pl[2] * pl[2]);
+                    visible = pl[0] * p[0] + pl[1] * p[1] + pl[2] * p[2] + pl[3] >= -r * length;
+                }
+                if(visible) out->push_back(bvh->order[k]);
+            }
+        } else {
+            stack[depth++] = node->right;
+            stack[depth++] = index + 1;
+        }
+    }
+}
@@ -0,0 +1,543 @@
+//	Exact chromatic number by DSATUR branch-and-bound
+//
+//	computeChromaticNumber( ) finds the fewest colors a level can be solved with.
+//	It starts from a greedy DSATUR coloring (upper bound) and a greedy clique
+//	(lower bound), then searches DSATUR order with per-node bitsets of the
+//	colors already taken by neighbors.  If the time budget runs out, the best
+//	coloring found so far is returned and exact is left at 0.
+//
+//	The search tree is spread over worker threads.  Each worker owns a deque of
+//	subtrees; when any worker goes idle, busy workers push their unexplored
+//	sibling branches so it can steal them.  The best color count is shared
+//	through an atomic so every worker prunes against the global bound.
+//
+//	Needs the Graph struct and its CSR index (buildAdjacency) to be defined first.
+
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// past this many nodes we only compute a greedy upper bound
+const int CHROMATIC_MAX_EXACT_NODES = 2000;
+
+// how many search nodes to expand between clock checks
+const int CHROMATIC_CLOCK_INTERVAL = 4096;
+
+typedef struct ChromaticResult {
+    int numColors;      // colors in the best coloring found
+    int lowerBound;     // size of the largest clique found
+    int exact;          // 1 if numColors is proven optimal
+    long long searchNodes;
+    double seconds;
+} ChromaticResult;
+
+
+static inline int
+firstZeroBit(const uint64_t *bits, int numWords, int limit)
+{
+    for(int w = 0; w < numWords; w++) {
+        uint64_t freeBits = ~bits[w];
+        if(freeBits != 0) {
+            int c = w * 64 + __builtin_ctzll(freeBits);
+            return c < limit ? c : limit;
+        }
+    }
+    return limit;
+}
+
+
+// Largest-degree-first greedy coloring, O(n + m).
+// Used as the upper bound on graphs too big for DSATUR.
+static int
+greedyLargestFirst(Graph graph, int *colors)
+{
+    int n = graph.numNodes;
+    int maxDegree = 0;
+    for(int v = 0; v < n; v++) {
+        int d = graph.adjOffsets[v + 1] - graph.adjOffsets[v];
+        if(d > maxDegree) maxDegree = d;
+    }
+
+    // counting sort by decreasing degree
+    std::vector<int> bucketStart(maxDegree + 2, 0);
+    for(int v = 0; v < n; v++) {
+        bucketStart[maxDegree - (graph.adjOffsets[v + 1] - graph.adjOffsets[v]) + 1]++;
+    }
+    for(int d = 0; d <= maxDegree; d++) {
+        bucketStart[d + 1] += bucketStart[d];
+    }
+    std::vector<int> order(n);
+    for(int v = 0; v < n; v++) {
+        order[bucketStart[maxDegree - (graph.adjOffsets[v + 1] - graph.adjOffsets[v])]++] = v;
+    }
+
+    std::vector<int> stamp(maxDegree + 2, -1);
+    int numColors = 0;
+    for(int v = 0; v < n; v++) colors[v] = -1;
+    for(int i = 0; i < n; i++) {
+        int v = order[i];
+        for(int k = graph.adjOffsets[v]; k < graph.adjOffsets[v + 1]; k++) {
+            int c = colors[graph.adjNeighbors[k]];
+            if(c >= 0 && c <= maxDegree) stamp[c] = v;
+        }
+        int c = 0;
+        while(stamp[c] == v) c++;
+        colors[v] = c;
+        if(c + 1 > numColors) numColors = c + 1;
+    }
+    return numColors;
+}
+
+
+// Greedy DSATUR coloring: always color the node with the most distinctly
+// colored neighbors next.  O(n^2) node selection, fine for exact-sized levels.
+static int
+greedyDsatur(Graph graph, int *colors)
+{
+    int n = graph.numNodes;
+    int numWords = (n + 63) / 64;
+    std::vector<uint64_t> taken((size_t)n * numWords, 0);
+    std::vector<int> sat(n, 0);
+    int numColors = 0;
+
+    for(int v = 0; v < n; v++) colors[v] = -1;
+    for(int step = 0; step < n; step++) {
+        int best = -1;
+        int bestDegree = -1;
+        for(int v = 0; v < n; v++) {
+            if(colors[v] != -1) continue;
+            int d = graph.adjOffsets[v + 1] - graph.adjOffsets[v];
+            if(best == -1 || sat[v] > sat[best] || (sat[v] == sat[best] && d > bestDegree)) {
+                best = v;
+                bestDegree = d;
+            }
+        }
+
+        int c = firstZeroBit(&taken[(size_t)best * numWords], numWords, n);
+        colors[best] = c;
+        if(c + 1 > numColors) numColors = c + 1;
+
+        for(int k = graph.adjOffsets[best]; k < graph.adjOffsets[best + 1]; k++) {
+            int u = graph.adjNeighbors[k];
+            uint64_t *bits = &taken[(size_t)u * numWords];
+            uint64_t mask = 1ULL << (c & 63);
+            if((bits[c >> 6] & mask) == 0) {
+                bits[c >> 6] |= mask;
+                sat[u]++;
+            }
+        }
+    }
+    return numColors;
+}
+
+
+// Grow a clique greedily from each of the highest-degree nodes and keep the
+// largest one.  Any clique size is a lower bound on the chromatic number.
+static int
+greedyClique(Graph graph, std::vector<int> &clique)
+{
+    int n = graph.numNodes;
+    const int MAX_STARTS = 32;
+
+    std::vector<int> starts;
+    for(int v = 0; v < n; v++) starts.push_back(v);
+    int numStarts = n < MAX_STARTS ? n : MAX_STARTS;
+    std::partial_sort(starts.begin(), starts.begin() + numStarts, starts.end(),
+        [&graph](int a, int b) {
+            return graph.adjOffsets[a + 1] - graph.adjOffsets[a] > graph.adjOffsets[b + 1] - graph.adjOffsets[b];
+        });
+
+    std::vector<int> mark(n, 0);
+    int stampValue = 0;
+    std::vector<int> candidates, current, next;
+    clique.clear();
+
+    for(int s = 0; s < numStarts; s++) {
+        int v = starts[s];
+        current.assign(1, v);
+        candidates.clear();
+        for(int k = graph.adjOffsets[v]; k < graph.adjOffsets[v + 1]; k++) {
+            if(graph.adjNeighbors[k] != v) candidates.push_back(graph.adjNeighbors[k]);
+        }
+
+        while(!candidates.empty()) {
+            // pick the candidate with the highest degree
+            int pick = candidates[0];
+            for(int u : candidates) {
+                if(graph.adjOffsets[u + 1] - graph.adjOffsets[u] > graph.adjOffsets[pick + 1] - graph.adjOffsets[pick]) pick = u;
+            }
+            current.push_back(pick);
+
+            // keep only candidates adjacent to pick
+            stampValue++;
+            for(int k = graph.adjOffsets[pick]; k < graph.adjOffsets[pick + 1]; k++) {
+                mark[graph.adjNeighbors[k]] = stampValue;
+            }
+            next.clear();
+            for(int u : candidates) {
+                if(u != pick && mark[u] == stampValue) next.push_back(u);
+            }
+            candidates.swap(next);
+        }
+
+        if(current.size() > clique.size()) clique = current;
+    }
+    return (int)clique.size();
+}
+
+
+// Branch-and-bound state for one DSATUR search.
+// taken[v] has bit c set while some colored neighbor of v uses color c;
+// count[v][c] says how many do, so unassign() can clear the bit again.
+class DsaturSearch
+{
+public:
+    DsaturSearch(Graph graph, int maxColors)
+    {
+        g = graph;
+        n = graph.numNodes;
+        k = maxColors;
+        numWords = (k + 63) / 64;
+        color.assign(n, -1);
+        count.assign((size_t)n * k, 0);
+        taken.assign((size_t)n * numWords, 0);
+        sat.assign(n, 0);
+        freeDegree.resize(n);
+        for(int v = 0; v < n; v++) {
+            freeDegree[v] = graph.adjOffsets[v + 1] - graph.adjOffsets[v];
+        }
+        numColored = 0;
+        numUsed = 0;
+    }
+
+    void assign(int v, int c)
+    {
+        color[v] = c;
+        numColored++;
+        for(int e = g.adjOffsets[v]; e < g.adjOffsets[v + 1]; e++) {
+            int u = g.adjNeighbors[e];
+            freeDegree[u]--;
+            if(count[(size_t)u * k + c]++ == 0) {
+                taken[(size_t)u * numWords + (c >> 6)] |= 1ULL << (c & 63);
+                sat[u]++;
+            }
+        }
+    }
+
+    void unassign(int v)
+    {
+        int c = color[v];
+        for(int e = g.adjOffsets[v]; e < g.adjOffsets[v + 1]; e++) {
+            int u = g.adjNeighbors[e];
+            freeDegree[u]++;
+            if(--count[(size_t)u * k + c] == 0) {
+                taken[(size_t)u * numWords + (c >> 6)] &= ~(1ULL << (c & 63));
+                sat[u]--;
+            }
+        }
+        color[v] = -1;
+        numColored--;
+    }
+
+    // uncolored node with the highest saturation, ties broken by uncolored degree
+    int selectNode() const
+    {
+        int best = -1;
+        for(int v = 0; v < n; v++) {
+            if(color[v] != -1) continue;
+            if(best == -1 || sat[v] > sat[best] || (sat[v] == sat[best] && freeDegree[v] > freeDegree[best])) {
+                best = v;
+            }
+        }
+        return best;
+    }
+
+    bool isTaken(int v, int c) const
+    {
+        return (taken[(size_t)v * numWords + (c >> 6)] >> (c & 63)) & 1ULL;
+    }
+
+    Graph g;
+    int n;
+    int k;
+    int numWords;
+    std::vector<int> color;
+    std::vector<int> count;
+    std::vector<uint64_t> taken;
+    std::vector<int> sat;
+    std::vector<int> freeDegree;
+    int numColored;
+    int numUsed;
+};
+
+
+// A unit of stealable work: the (node, color) decisions from the root of
+// the search tree down to the subtree still to be explored.
+typedef std::vector<std::pair<int, int> > ChromaticTask;
+
+// One worker's deque.  The owner pushes and pops at the back (depth first),
+// thieves take from the front, where the largest untouched subtrees sit.
+class ChromaticQueue
+{
+public:
+    void push(const ChromaticTask &task)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tasks.push_back(task);
+    }
+
+    bool popBack(ChromaticTask &task)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if(tasks.empty()) return false;
+        task.swap(tasks.back());
+        tasks.pop_back();
+        return true;
+    }
+
+    bool empty()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return tasks.empty();
+    }
+
+    bool stealFront(ChromaticTask &task)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if(tasks.empty()) return false;
+        task.swap(tasks.front());
+        tasks.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex lock;
+    std::deque<ChromaticTask> tasks;
+};
+
+
+// State shared by all workers of one computeChromaticNumber( ) call.
+// bestColors is read without locking on every branch; the coloring behind
+// it is only touched under bestLock.
+typedef struct ChromaticShared {
+    int lowerBound;
+    std::atomic<int> bestColors;
+    std::mutex bestLock;
+    std::vector<int> bestColoring;
+    std::atomic<long long> nodes;
+    std::atomic<bool> aborted;
+    std::atomic<int> idleWorkers;
+    std::atomic<long> pendingTasks;     // queued or running tasks
+    std::chrono::steady_clock::time_point deadline;
+    std::vector<ChromaticQueue> *queues;
+} ChromaticShared;
+
+
+// Per-thread search state
+typedef struct ChromaticWorker {
+    int id;
+    ChromaticTask path;                 // decisions from the root to the current node
+    long long nodes;
+} ChromaticWorker;
+
+
+static inline bool
+childAllowed(const DsaturSearch &s, int bestColors, int v, int c)
+{
+    if(c < s.numUsed) {
+        return s.numUsed < bestColors && !s.isTaken(v, c);
+    }
+    return s.numUsed + 1 < bestColors;     // opening a new color
+}
+
+
+static void
+dsaturBranch(DsaturSearch &s, ChromaticShared &sh, ChromaticWorker &w)
+{
+    if(sh.aborted.load(std::memory_order_relaxed) ||
+       sh.bestColors.load(std::memory_order_relaxed) == sh.lowerBound) {
+        return;
+    }
+    if(++w.nodes % CHROMATIC_CLOCK_INTERVAL == 0 && std::chrono::steady_clock::now() > sh.deadline) {
+        sh.aborted.store(true);
+        return;
+    }
+
+    if(s.numColored == s.n) {
+        std::lock_guard<std::mutex> guard(sh.bestLock);
+        if(s.numUsed < sh.bestColors.load()) {
+            sh.bestColoring = s.color;
+            sh.bestColors.store(s.numUsed);
+        }
+        return;
+    }
+
+    int v = s.selectNode();
+
+    // colors 0..numUsed-1 reuse an existing color, numUsed opens a new one
+    int last = s.numUsed;
+    for(int c = 0; c <= last; c++) {
+        if(!childAllowed(s, sh.bestColors.load(std::memory_order_relaxed), v, c)) continue;
+
+        // Somebody is out of work and we have nothing queued for them:
+        // hand them our remaining siblings
+        if(c < last && sh.idleWorkers.load(std::memory_order_relaxed) > 0 && (*sh.queues)[w.id].empty()) {
+            for(int c2 = c + 1; c2 <= last; c2++) {
+                if(!childAllowed(s, sh.bestColors.load(std::memory_order_relaxed), v, c2)) continue;
+                ChromaticTask task = w.path;
+                task.push_back(std::make_pair(v, c2));
+                sh.pendingTasks++;
+                (*sh.queues)[w.id].push(task);
+            }
+            last = c;
+        }
+
+        bool newColor = (c == s.numUsed);
+        s.assign(v, c);
+        if(newColor) s.numUsed++;
+        w.path.push_back(std::make_pair(v, c));
+
+        dsaturBranch(s, sh, w);
+
+        w.path.pop_back();
+        if(newColor) s.numUsed--;
+        s.unassign(v);
+        if(sh.aborted.load(std::memory_order_relaxed)) return;
+    }
+}
+
+
+// Replay a task's decisions, search below them, then undo them again
+static void
+runChromaticTask(DsaturSearch &s, ChromaticShared &sh, ChromaticWorker &w, const ChromaticTask &task)
+{
+    for(size_t i = 0; i < task.size(); i++) {
+        s.assign(task[i].first, task[i].second);
+        if(task[i].second + 1 > s.numUsed) s.numUsed = task[i].second + 1;
+    }
+    w.path = task;
+
+    dsaturBranch(s, sh, w);
+
+    for(size_t i = task.size(); i-- > 0; ) {
+        s.unassign(task[i].first);
+    }
+    s.numUsed = 0;
+}
+
+
+static void
+chromaticWorkerLoop(Graph graph, ChromaticShared *sh, int id, int numThreads)
+{
+    DsaturSearch s(graph, sh->bestColors.load());
+    ChromaticWorker w;
+    w.id = id;
+    w.nodes = 0;
+
+    std::vector<ChromaticQueue> &queues = *sh->queues;
+    ChromaticTask task;
+    bool idle = false;
+    while(true) {
+        bool found = queues[id].popBack(task);
+        for(int i = 1; i < numThreads && !found; i++) {
+            found = queues[(id + i) % numThreads].stealFront(task);
+        }
+
+        if(found) {
+            if(idle) {
+                sh->idleWorkers--;
+                idle = false;
+            }
+            runChromaticTask(s, *sh, w, task);
+            sh->pendingTasks--;
+            continue;
+        }
+
+        if(!idle) {
+            sh->idleWorkers++;
+            idle = true;
+        }
+        if(sh->pendingTasks.load() == 0) break;
+        std::this_thread::yield();
+    }
+    if(idle) sh->idleWorkers--;
+
+    sh->nodes += w.nodes;
+}
+
+
+// Compute the chromatic number of graph within timeBudget seconds, searching
+// on numThreads threads (0 = one per core).  If coloringOut is not NULL it
+// receives the best coloring found (numNodes entries).
+ChromaticResult
+computeChromaticNumber(Graph graph, double timeBudget, int *coloringOut, int numThreads)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ChromaticResult result = {0, 0, 1, 0, 0.0};
+    int n = graph.numNodes;
+    if(n == 0) {
+        return result;
+    }
+
+    if(numThreads <= 0) {
+        numThreads = (int)std::thread::hardware_concurrency();
+        if(numThreads <= 0) numThreads = 1;
+    }
+
+    ChromaticShared sh;
+    std::vector<ChromaticQueue> queues(numThreads);
+    sh.queues = &queues;
+    sh.bestColoring.resize(n);
+    sh.nodes = 0;
+    sh.aborted = false;
+    sh.idleWorkers = 0;
+    sh.pendingTasks = 0;
+    sh.deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(timeBudget));
+
+    std::vector<int> clique;
+    sh.lowerBound = greedyClique(graph, clique);
+
+    if(n > CHROMATIC_MAX_EXACT_NODES) {
+        sh.bestColors = greedyLargestFirst(graph, &sh.bestColoring[0]);
+        sh.aborted = sh.bestColors.load() > sh.lowerBound;
+    } else {
+        sh.bestColors = greedyDsatur(graph, &sh.bestColoring[0]);
+
+        if(sh.bestColors.load() > sh.lowerBound) {
+            // The root task colors the clique first: any optimal coloring can be
+            // relabeled to give it colors 0..q-1, which removes that symmetry.
+            ChromaticTask root;
+            for(int i = 0; i < (int)clique.size(); i++) {
+                root.push_back(std::make_pair(clique[i], i));
+            }
+            sh.pendingTasks = 1;
+            queues[0].push(root);
+
+            std::vector<std::thread> threads;
+            for(int i = 1; i < numThreads; i++) {
+                threads.push_back(std::thread(chromaticWorkerLoop, graph, &sh, i, numThreads));
+            }
+            chromaticWorkerLoop(graph, &sh, 0, numThreads);
+            for(size_t i = 0; i < threads.size(); i++) {
+                threads[i].join();
+            }
+        }
+    }
+
+    result.numColors = sh.bestColors.load();
+    result.lowerBound = sh.lowerBound;
+    result.exact = (!sh.aborted.load() || result.numColors == sh.lowerBound) ? 1 : 0;
+    result.searchNodes = sh.nodes.load();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(coloringOut != NULL) {
+        memcpy(coloringOut, &sh.bestColoring[0], n * sizeof(int));
+    }
+    return result;
+}
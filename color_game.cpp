@@ -2,6 +2,13 @@
 #include <stdlib.h>
 #include <ctype.h>
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <sys/time.h>
+#endif
+
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -26,26 +33,25 @@
 
 // Maximum number of colors
 #define MAX_COLORS 6
-#define NUM_LEVELS 2
-
-
-typedef struct Node {
-    int id;
-    float position[3]; // x, y, z coordinates
-    int color;          // -1 for uncolored, 0 to MAX_COLORS-1 for colors
-} Node;
 
-typedef struct Edge {
-    int from;
-    int to;
-} Edge;
 
-typedef struct Graph {
-    Node *nodes;
-    int numNodes;
-    Edge *edges;
-    int numEdges;
-} Graph;
+#include "graph.cpp"
+#include "bitmatrix.cpp"
+#include "journal.cpp"
+#include "gamecore.cpp"
+#include "chromatic.cpp"
+#include "levelpack.cpp"
+#include "importer.cpp"
+#include "layout.cpp"
+#include "renderstats.cpp"
+#include "instancing.cpp"
+#include "edgebuffer.cpp"
+#include "bvh.cpp"
+#include "animclock.cpp"
+#include "transition.cpp"
+#include "hint.cpp"
+#include "tabucol.cpp"
+#include "headless.cpp"
 
 
 
@@ -219,33 +225,61 @@ float	Time;					// used for animation, this has a value between 0. and 1.
 int		Xmouse, Ymouse;			// mouse values
 float	Xrot, Yrot;				// rotation angles in degrees
 GLuint  sphereList;
-int 	selectedNode = -1; // -1 indicates no selection
+// Node level of detail: sphere tessellations from finest to coarsest, and the
+// smallest on-screen radius in pixels each one is used down to.  Nodes smaller
+// than the last are drawn as points.
+const int   NODE_LODS = 3;
+const int   NODE_LOD_SLICES[NODE_LODS] = { 20, 10, 6 };
+const float NODE_LOD_MIN_PIXELS[NODE_LODS] = { 12.f, 4.f, 1.5f };
+GLuint  sphereLodLists[NODE_LODS];  // sphereLodLists[0] is sphereList
+int     NodeLodMeshes[NODE_LODS];   // the same tessellations as NodeSpheres meshes
+NodeInstancer NodeSpheres;          // instanced sphere renderer, if the GL supports it
+std::vector<float> NodeInstanceData[NODE_LODS + 1];  // per-frame node positions and colors for each LOD, then points
+std::vector<int> VisibleNodes;      // nodes inside the view frustum this frame
+int     InstancedNodesOn = 1;       // != 0 means draw nodes with NodeSpheres
+int     NodeCullingOn = 1;          // != 0 means frustum cull and pick a LOD per node
+bool    Headless = false;           // rendering offscreen with no GLUT window (--headless)
+EdgeBuffer EdgeLines;               // every edge of the current level, drawn in one call
+NodeBvh NodeTree;                   // node spheres of NodeTreeLevel, for picking and culling
+int     NodeTreeLevel = -1;         // level NodeTree was built for, -1 if none
+std::vector<float> NodeTreePositions;   // node positions NodeTree is built or refit from
 float 	Tx = 0.0f, Ty = 0.0f;
 // Graph Levels
-Graph   levels[NUM_LEVELS];
-int     currentLevel = 0;
-// Scoring Variables
-int 	score = 0;
-int 	moves = 0;
+Graph  *levels = NULL;
+int     numLevels = 0;
+const char *LevelFilePath = NULL;   // level pack or graph file given on the command line, if any
+LevelPack CurrentPack;              // the mapped pack while levels come from one
+const char *LAYOUT_CACHE_DIR = "layout_cache";
+// Level, score, moves and selection: everything the player changes
+GameState Game;
 int     CurrentColor = -1;  
 // Transition variables
 float transitionTime = 0.0f;       // Time counter for transition
 bool inTransition = false;         // Whether we're in transition
 bool edgesVisible = true;          // Whether to draw edges
-Node startPositions[5];           // Store starting positions
-Node endPositions[5];             // Store end positions
+std::vector<TransitionPlan> LevelTransitions;  // LevelTransitions[l] morphs level l into level l+1
+Graph MorphGraph;                  // The morph nodes of the running transition, drawn instead of the level
 const float TRANSITION_DURATION = 2.0f;  // Seconds for transition
+const float ANIMATION_STEP = 1.0f / 60.0f; // Seconds the transition advances per step
+const int   ANIMATION_MAX_STEPS = 15;      // Most steps to catch up after a stall
+AnimationClock TransitionClock;            // Steps the transition in wall-clock time
+bool AnimationTimerArmed = false;          // An AnimationTimer( ) call is pending
+bool SceneDirty = true;                    // Something on screen changed since the last frame
 float CameraY = 0.0f;
 float StartCameraY = 0.0f;
 float EndCameraY = -1.5f;
-bool gameCompleted = false;
 const char* VICTORY_TEXT = "3D Color Graph Game";
 GLuint textDisplayList;
 const char* CREDITS_TEXT = "By Guillermo Morales";
 // function prototypes:
 
 void	Animate( );
+void	AnimationTimer( int );
+void	StartAnimation( );
+void	PostRedraw( );
 void	Display( );
+void	RenderScene( int, int );
+int		RunHeadless( int, char *[ ] );
 void	DoAxesMenu( int );
 void	DoColorMenu( int );
 void	DoDepthBufferMenu( int );
@@ -266,7 +300,7 @@ void	MouseMotion( int, int );
 void	Reset( );
 void	Resize( int, int );
 void	Visibility( int );
-void 	provideFeedback();
+void 	provideFeedback( int );
 void			Axes( float );
 void			HsvRgb( float[3], float [3] );
 void			Cross(float[3], float[3], float[3]);
@@ -326,13 +360,9 @@ MulArray3(float factor, float a, float b, float c )
 //#include "osutorus.cpp"
 //#include "bmptotexture.cpp"
 //#include "loadobjfile.cpp"
-#include "keytime.cpp"
+//#include "keytime.cpp"
 //#include "glslprogram.cpp"
 
-Keytimes xPos[5];  // Array for each node's x position
-Keytimes yPos[5];  // Array for each node's y position
-Keytimes zPos[5];  // Array for each node's z position
-
 // Function to initialize Level 1 (Square)
 Graph createLevel1() {
     Graph g;
@@ -362,6 +392,14 @@ Graph createLevel1() {
     g.edges[2] = (Edge){2, 3};
     g.edges[3] = (Edge){3, 0};
 
+    // The neighbor index is built in initializeLevels() once the edges are final
+    g.adjOffsets = NULL;
+    g.adjNeighbors = NULL;
+    g.adjMatrix = NULL;
+    g.adjMatrixWords = 0;
+    g.optimalColors = 0;
+    g.packed = 0;
+
     return g;
 }
 
@@ -412,153 +450,346 @@ Graph createLevel1() {
 }
 
 
+// Seconds each level may spend proving its chromatic number at startup
+const double CHROMATIC_TIME_BUDGET = 0.25;
+
+// Seconds tabu search may spend lowering the bound when that was not exact
+const double TABU_TIME_BUDGET = 2.0;
+
+// Seconds a hint may search for; well inside one frame
+const double HINT_TIME_BUDGET = 0.004;
+
+HintEngine Hints;
 
+// Every move on the current level, for undo and redo
+MoveJournal Journal;
 
+// Print how the level just solved was scored; scoreLevel() does the math
 void calculateScore() {
-    Graph currentGraph = levels[currentLevel];
-    
-    // Count how many different colors were used
-    int usedColors[MAX_COLORS] = {0};  // Track which colors are used
-    int numColorsUsed = 0;
-    
-    for(int i = 0; i < currentGraph.numNodes; i++) {
-        if(currentGraph.nodes[i].color >= 0 && usedColors[currentGraph.nodes[i].color] == 0) {
-            usedColors[currentGraph.nodes[i].color] = 1;
-            numColorsUsed++;
-        }
-    }
-    
-    // Base score: 100 points per level
-    int baseScore = 100;
-    
-    // Penalty for moves
-    int penalties = (moves * 2);
-    
-    // Bonus for using fewer colors
-    // For level 1 (square): optimal is 2 colors
-    // For level 2 (square with center): optimal is 3 colors
-    int optimalColors;
-    if(currentLevel == 0) {
-        optimalColors = 2;  // Square can be colored with 2 colors
-    } else if(currentLevel == 1) {
-        optimalColors = 3;  // Square with center needs 3 colors
-    } else {
-        optimalColors = 3;  // Default for other levels
-    }
-    
-    // Bonus points for being close to optimal coloring
-    int colorBonus = 50 * (MAX_COLORS - numColorsUsed);
-    if(numColorsUsed == optimalColors) {
-        colorBonus += 100;  // Extra bonus for achieving optimal coloring
-    }
-    
-    // Calculate final score
-    score += baseScore + colorBonus - penalties;
-    if(score < 0) score = 0;
-    
-    printf("Level %d scoring:\n", currentLevel + 1);
-    printf("Base score: %d\n", baseScore);
-    printf("Colors used: %d (optimal: %d)\n", numColorsUsed, optimalColors);
-    printf("Color bonus: %d\n", colorBonus);
-    printf("Penalties: %d\n", penalties);
-    printf("Final score for level: %d\n", baseScore + colorBonus - penalties);
+    LevelScore s = scoreLevel(&Game);
+
+    printf("Level %d scoring:\n", Game.currentLevel + 1);
+    printf("Base score: %d\n", s.baseScore);
+    printf("Colors used: %d (optimal: %d)\n", s.colorsUsed, s.optimalColors);
+    printf("Color bonus: %d\n", s.colorBonus);
+    printf("Penalties: %d\n", s.penalties);
+    printf("Final score for level: %d\n", s.total);
 }
 int isValidColoring(Graph graph) {
-    // First check if all nodes are colored
-    for(int i = 0; i < graph.numNodes; i++) {
-        if(graph.nodes[i].color == -1) {
-            return 0; // Not all nodes are colored yet
-        }
-    }
-    
-    // Then check if any adjacent nodes share colors
-    for(int i = 0; i < graph.numEdges; i++) {
-        int from = graph.edges[i].from;
-        int to = graph.edges[i].to;
-        if(graph.nodes[from].color == graph.nodes[to].color) {
-            return 0; // Invalid coloring
-        }
-    }
-    return 1; // Valid coloring - all nodes colored and no conflicts
+    return isLevelSolved(graph);
 }
-void provideFeedback() {
-    Graph currentGraph = levels[currentLevel];
-    int allColored = 1;
-    int validColoring = 1;
+void provideFeedback(int recoloredNode) {
+    Graph currentGraph = levels[Game.currentLevel];
+    int allColored = currentGraph.numUncolored == 0;
+    int validColoring = currentGraph.numConflicts == 0;
     
-    // Check if all nodes are colored
-    for(int i = 0; i < currentGraph.numNodes; i++) {
-        printf("Node %d color: %d\n", i, currentGraph.nodes[i].color);
-        if(currentGraph.nodes[i].color == -1) {
-            allColored = 0;
-            printf("Not all nodes are colored yet\n");
-            break;
-        }
+    printf("Node %d color: %d\n", recoloredNode, currentGraph.nodes[recoloredNode].color);
+
+    // Name one conflict introduced by this move, if any
+    int other = findConflictingNeighbor(currentGraph, recoloredNode);
+    if(other != -1) {
+        printf("Invalid coloring: nodes %d and %d share color %d\n", 
+               recoloredNode, other, currentGraph.nodes[recoloredNode].color);
     }
-    
-    // Check for adjacent nodes with same color
-    if(allColored) {
-        for(int i = 0; i < currentGraph.numEdges; i++) {
-            int from = currentGraph.edges[i].from;
-            int to = currentGraph.edges[i].to;
-            printf("Checking edge %d-%d: colors %d-%d\n", 
-                   from, to, 
-                   currentGraph.nodes[from].color, 
-                   currentGraph.nodes[to].color);
-            if(currentGraph.nodes[from].color == currentGraph.nodes[to].color) {
-                validColoring = 0;
-                printf("Invalid coloring: nodes %d and %d share color %d\n", 
-                       from, to, currentGraph.nodes[from].color);
-                break;
-            }
-        }
+
+    if(!allColored) {
+        printf("Not all nodes are colored yet (%d left)\n", currentGraph.numUncolored);
+    }
+    if(!validColoring) {
+        printf("Conflicting edges: %d\n", currentGraph.numConflicts);
     }
 
-    if(allColored && validColoring) {
+    // applyMove() has already scored the level if this move solved it
+    if(Game.levelSolved) {
         calculateScore();
-        printf("Level %d Completed! Score: %d\n", currentLevel + 1, score);
+        printf("Level %d Completed! Score: %d\n", Game.currentLevel + 1, Game.score);
         
-        if(currentLevel < NUM_LEVELS - 1) {
-            // Initialize keyframes for each node
-            Graph nextGraph = levels[currentLevel + 1];
-            
-            for(int i = 0; i < nextGraph.numNodes; i++) {
-                xPos[i].Init();
-                yPos[i].Init();
-                zPos[i].Init();
-                
-                // Current position at time 0
-                xPos[i].AddTimeValue(0.0, currentGraph.nodes[i].position[0]);
-                yPos[i].AddTimeValue(0.0, currentGraph.nodes[i].position[1]);
-                zPos[i].AddTimeValue(0.0, currentGraph.nodes[i].position[2]);
-                
-                // Target position at time 1
-                xPos[i].AddTimeValue(1.0, nextGraph.nodes[i].position[0]);
-                yPos[i].AddTimeValue(1.0, nextGraph.nodes[i].position[1]);
-                zPos[i].AddTimeValue(1.0, nextGraph.nodes[i].position[2]);
-            }
+        if(!Game.gameCompleted) {
+            // Morph into the next level along the paths planned at load;
+            // only the colors of this level's nodes are new
+            TransitionPlan *plan = &LevelTransitions[Game.currentLevel];
+            startTransition(plan, &levels[Game.currentLevel]);
+            memset(&MorphGraph, 0, sizeof(MorphGraph));
+            MorphGraph.nodes = plan->nodes.empty() ? NULL : &plan->nodes[0];
+            MorphGraph.numNodes = (int)plan->nodes.size();
+            MorphGraph.packed = 1;
+            Game.selectedNode = -1;
+            NodeTreeLevel = -1;     // the tree holds the morph nodes from now on
             
             // Start transition
             inTransition = true;
             transitionTime = 0.0f;
             edgesVisible = false;
             CameraY = StartCameraY;  // Reset camera Y to starting position
+            StartAnimation();
             
             printf("Starting transition to next level\n");
         } else {
             // Game completion
-            printf("Congratulations! Final Score: %d\n", score);
-            gameCompleted = true;  // Set game completed flag
-            glutPostRedisplay();
+            printf("Congratulations! Final Score: %d\n", Game.score);
         }
-        glutPostRedisplay();
+        PostRedraw();
+    }
+}
+
+// Color the selected node from the keyboard.  The move is ignored while
+// nothing is selected or the level is already solved.
+void colorSelectedNode(int color) {
+    if(Game.selectedNode == -1) {
+        return;
     }
+    if(applyMove(&Game, Game.selectedNode, color) == MOVE_REJECTED) {
+        return;
+    }
+    provideFeedback(Game.selectedNode);
+    PostRedraw();
+}
+
+// Undo (or redo) a move from the keyboard and select the node it changed.
+// Ignored when there is nothing to step through or the level is solved.
+void stepJournal(int redo) {
+    if(inTransition) {
+        return;
+    }
+    size_t position = Journal.position;
+    if((redo ? redoGameMove(&Game) : undoGameMove(&Game)) == MOVE_REJECTED) {
+        printf("Nothing to %s\n", redo ? "redo" : "undo");
+        return;
+    }
+    int node = movedNode(Journal.entries[redo ? position : position - 1]);
+    Game.selectedNode = node;
+    provideFeedback(node);
+    PostRedraw();
+}
+
+// Suggest a move for the current level, select its node and say what to do
+void showHint() {
+    if(inTransition || Game.levelSolved) {
+        return;
+    }
+    Hint hint = findHint(&Hints, &levels[Game.currentLevel], 0, HINT_TIME_BUDGET);
+    const char *colorName = hint.color >= 0 ? ColorNames[hint.color] : "no color";
+
+    switch(hint.kind) {
+        case HINT_COLOR:
+            printf("Hint: color node %d %s\n", hint.node, colorName);
+            break;
+        case HINT_GUESS:
+            printf("Hint: try node %d %s (not proven to finish)\n", hint.node, colorName);
+            break;
+        case HINT_FIX_CONFLICT:
+            printf("Hint: node %d clashes with a neighbor; make it %s\n", hint.node, colorName);
+            break;
+        case HINT_BLOCKED:
+            if(hint.node != -1) {
+                printf("Hint: this cannot be finished in %d colors; clear node %d\n", hint.numColors, hint.node);
+            } else {
+                printf("Hint: this cannot be finished in %d colors\n", hint.numColors);
+            }
+            break;
+        default:
+            return;
+    }
+    if(hint.node != -1 && hint.node != Game.selectedNode) {
+        Game.selectedNode = hint.node;
+        PostRedraw();
+    }
+}
+
+// Release the current levels, whether built in or from a level pack
+void freeLevels() {
+    for(int i = 0; i < numLevels; i++) {
+        freeGraph(&levels[i]);
+    }
+
+    if(CurrentPack.data != NULL) {
+        closeLevelPack(&CurrentPack);   // also frees the levels array
+    } else {
+        free(levels);
+    }
+    levels = NULL;
+    numLevels = 0;
+    LevelTransitions.clear();
+    InvalidateEdgeBuffer(&EdgeLines);
+    NodeTreeLevel = -1;
+}
+
+// Import a DIMACS .col or edge-list file as the only level
+int importLevel(const char *path) {
+    Graph imported;
+    ImportStats stats;
+    if(!importGraphFile(path, &imported, &stats)) {
+        return 0;
+    }
+
+    // A clique bigger than the palette can never be colored in the game
+    buildAdjacency(&imported);
+    std::vector<int> clique;
+    if(greedyClique(imported, clique) > MAX_COLORS) {
+        fprintf(stderr, "%s has %d nodes that all touch each other, but the game only has %d colors\n",
+                path, (int)clique.size(), MAX_COLORS);
+        freeGraph(&imported);
+        return 0;
+    }
+
+    numLevels = 1;
+    levels = (Graph *)calloc(numLevels, sizeof(Graph));
+    if (!levels) {
+        fprintf(stderr, "Memory allocation failed for levels\n");
+        exit(EXIT_FAILURE);
+    }
+    levels[0] = imported;
+
+    // Imported graphs have no positions of their own: reuse the cached
+    // layout when this exact graph has been seen before
+    LayoutOptions layout;
+    defaultLayoutOptions(&layout, levels[0].numNodes);
+    double layoutStart = ElapsedSeconds();
+    int cached = computeCachedLayout(&levels[0], &layout, LAYOUT_CACHE_DIR);
+    printf("%s %d nodes in %.2f s\n", cached ? "Loaded cached layout for" : "Laid out",
+           levels[0].numNodes, ElapsedSeconds() - layoutStart);
+
+    printf("Imported %s: %d nodes, %d edges (%lld duplicates, %lld self-loops dropped), %.1f MB/s\n",
+           path, imported.numNodes, imported.numEdges, stats.duplicateEdges, stats.selfLoops,
+           stats.seconds > 0.0 ? stats.bytes / (1024.0 * 1024.0) / stats.seconds : 0.0);
+    return 1;
+}
+
+// Name of the file in cacheDir holding g's color target, keyed by its
+// edge set like the cached layouts
+void colorTargetPath(const Graph *g, const char *cacheDir, char *path, size_t size) {
+    uint64_t hash[2];
+    hashGraphEdges(g, hash);
+    snprintf(path, size, "%s/%016llx%016llx.colors", cacheDir,
+             (unsigned long long)hash[0], (unsigned long long)hash[1]);
+}
+
+// Set g->optimalColors from the cache.  Returns 1 if it was there.
+int loadCachedColorTarget(Graph *g, const char *cacheDir) {
+    char path[1024];
+    colorTargetPath(g, cacheDir, path, sizeof(path));
+    FILE *fp = fopen(path, "r");
+    if(fp == NULL) {
+        return 0;
+    }
+    int colors = 0;
+    int ok = fscanf(fp, "%d", &colors) == 1 && colors > 0;
+    fclose(fp);
+    if(ok) {
+        g->optimalColors = colors;
+    }
+    return ok;
+}
+
+// Store g->optimalColors in the cache.  It is written under a temporary
+// name and renamed into place, so a reader never sees half a file; the
+// level files themselves are never touched.  Returns 1 once it is there.
+int saveCachedColorTarget(const Graph *g, const char *cacheDir) {
+    char path[1024], tmpPath[1040];
+    colorTargetPath(g, cacheDir, path, sizeof(path));
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+#ifdef WIN32
+    _mkdir(cacheDir);
+#else
+    mkdir(cacheDir, 0755);
+#endif
+    FILE *fp = fopen(tmpPath, "w");
+    if(fp == NULL) {
+        return 0;
+    }
+    int ok = fprintf(fp, "%d\n", g->optimalColors) > 0;
+    if(fclose(fp) != 0) ok = 0;
+    if(!ok || rename(tmpPath, path) != 0) {
+        fprintf(stderr, "Could not save the color target to %s\n", path);
+        remove(tmpPath);
+        return 0;
+    }
+    return 1;
 }
 
 // Function to initialize all levels
+// Levels come from the level pack or graph file named on the command line,
+// or the two built-in levels if there is none
 void initializeLevels() {
-    levels[0] = createLevel1();
-    levels[1] = createLevel2();
+    freeLevels();
+
+    if(LevelFilePath != NULL && isLevelPackFile(LevelFilePath) && openLevelPack(LevelFilePath, &CurrentPack)) {
+        levels = CurrentPack.levels;
+        numLevels = CurrentPack.numLevels;
+        printf("Loaded %d levels from %s\n", numLevels, LevelFilePath);
+    } else if(LevelFilePath != NULL && !isLevelPackFile(LevelFilePath) && importLevel(LevelFilePath)) {
+        // levels were set by importLevel()
+    } else {
+        numLevels = 2;
+        levels = (Graph *)calloc(numLevels, sizeof(Graph));
+        if (!levels) {
+            fprintf(stderr, "Memory allocation failed for levels\n");
+            exit(EXIT_FAILURE);
+        }
+        levels[0] = createLevel1();
+        levels[1] = createLevel2();
+    }
+
+    for(int i = 0; i < numLevels; i++) {
+        if(levels[i].adjOffsets == NULL) {
+            buildAdjacency(&levels[i]);
+        }
+        if(levels[i].adjMatrix == NULL && wantsAdjacencyMatrix(&levels[i])) {
+            buildAdjacencyMatrix(&levels[i]);
+            printf("Level %d is dense: using a %d-word-per-row adjacency matrix\n", i + 1, levels[i].adjMatrixWords);
+        }
+        resetColoring(&levels[i]);
+
+        // Packs can carry the answer already, and a search that ran out of
+        // time on an earlier load left its result in the cache
+        if(levels[i].optimalColors > 0) {
+            continue;
+        }
+        if(loadCachedColorTarget(&levels[i], LAYOUT_CACHE_DIR)) {
+            printf("Level %d needs %d colors (cached)\n", i + 1, levels[i].optimalColors);
+            continue;
+        }
+
+        std::vector<int> coloring(levels[i].numNodes > 0 ? levels[i].numNodes : 1);
+        ChromaticResult chromatic = computeChromaticNumber(levels[i], CHROMATIC_TIME_BUDGET, &coloring[0], 0);
+        levels[i].optimalColors = chromatic.numColors;
+        printf("Level %d needs %d colors (%s, %.3f s)\n", i + 1, chromatic.numColors,
+               chromatic.exact ? "optimal" : "best found", chromatic.seconds);
+
+        // Too big or too hard to prove: tighten the target with tabu search
+        if(!chromatic.exact) {
+            TabuResult tabu = improveColoringTabu(levels[i], &coloring[0], chromatic.numColors,
+                                                  chromatic.lowerBound, TABU_TIME_BUDGET, 0, (unsigned int)i);
+            levels[i].optimalColors = tabu.numColors;
+            printf("Level %d: tabu search found %d colors (%lld moves, %.3f s)\n", i + 1, tabu.numColors,
+                   tabu.iterations, tabu.seconds);
+            if(saveCachedColorTarget(&levels[i], LAYOUT_CACHE_DIR)) {
+                printf("Saved the color target of level %d to %s\n", i + 1, LAYOUT_CACHE_DIR);
+            }
+        }
+        if(levels[i].optimalColors > MAX_COLORS) {
+            fprintf(stderr, "Warning: level %d needs %d colors but the game only has %d\n", i + 1,
+                    levels[i].optimalColors, MAX_COLORS);
+        }
+    }
+
+    // Plan every transition now, so finishing a level never waits on it
+    double planStart = ElapsedSeconds();
+    LevelTransitions.resize(numLevels > 1 ? numLevels - 1 : 0);
+    for(int i = 0; i + 1 < numLevels; i++) {
+        TransitionPlan *plan = &LevelTransitions[i];
+        planTransition(&levels[i], &levels[i + 1], plan);
+        printf("Transition %d -> %d: %d nodes move, %d spawn, %d despawn\n", i + 1, i + 2,
+               plan->numMatched, plan->numSpawned, plan->numDespawned);
+    }
+    if(numLevels > 1) {
+        printf("Planned %d transitions in %.3f s\n", numLevels - 1, ElapsedSeconds() - planStart);
+    }
+
+    initGame(&Game, levels, numLevels);
+    clearMoveJournal(&Journal);
+    Game.journal = &Journal;
 }
 
 void drawNode(Node node) {
@@ -581,7 +812,7 @@ void drawNode(Node node) {
         mat_diffuse[2] = Colors[node.color][2];
         mat_diffuse[3] = 1.0f;
         glColor3fv(Colors[node.color]);
-    } else if(node.id == selectedNode) {
+    } else if(node.id == Game.selectedNode) {
         // gray for selected
         glColor3f(1.0f, 1.0f, 0.0f);
     } else {
@@ -597,134 +828,277 @@ void drawNode(Node node) {
     glPopMatrix();
 }
 
-void drawEdge(Edge edge, Graph graph) {
-    Node from = graph.nodes[edge.from];
-    Node to = graph.nodes[edge.to];
-    
-    glDisable(GL_LIGHTING);  // Disable lighting for lines
-    glLineWidth(3.0);        // Make lines thicker
-    
-    // Check if connected nodes have the same color
-    if(from.color != -1 && to.color != -1 && from.color == to.color) {
-        glColor3f(1.0f, 0.0f, 0.0f);  // Bright red for conflicts
+// Color a node is drawn with: its own color, gray when selected, else white
+void nodeDrawColor(Node node, float color[3]) {
+    if(node.color >= 0 && node.color < MAX_COLORS) {
+        color[0] = Colors[node.color][0];
+        color[1] = Colors[node.color][1];
+        color[2] = Colors[node.color][2];
+    } else if(node.id == Game.selectedNode) {
+        color[0] = color[1] = color[2] = 0.3f;
     } else {
-        glColor3f(1.0f, 1.0f, 1.0f);  // Bright white for normal edges
+        color[0] = color[1] = color[2] = 1.0f;  // White for uncolored
     }
-
-    glBegin(GL_LINES);
-        glVertex3f(from.position[0], from.position[1], from.position[2]);
-        glVertex3f(to.position[0], to.position[1], to.position[2]);
-    glEnd();
-    
-    glEnable(GL_LIGHTING);  // Re-enable lighting for other rendering
 }
 
+// The nodes on screen: the current level's, or the morph nodes while a
+// transition runs
+Graph *drawnGraph() {
+    return inTransition ? &MorphGraph : &levels[Game.currentLevel];
+}
 
-void drawText(const char *text, float x, float y, float z) {
-    glRasterPos3f(x, y, z);
-    for(const char *c = text; *c != '\0'; c++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
+// Bring NodeTree up to date with where the drawn nodes are:
+// build it for a new level, refit it while a transition moves the nodes.
+// While a transition runs, every node's position is evaluated here once per
+// step, and drawing and picking both read it from NodeTree.
+void updateNodeTree() {
+    Graph *graph = drawnGraph();
+    NodeTreePositions.resize((size_t)graph->numNodes * 3);
+    if(inTransition) {
+        // Calculate normalized time (0 to 1)
+        float t = transitionTime / TRANSITION_DURATION;
+        if(t > 1.0f) t = 1.0f;
+        const TransitionPaths *paths = &LevelTransitions[Game.currentLevel].paths;
+        if(!NodeTreePositions.empty()) evaluateTransitionPaths(paths, t, &NodeTreePositions[0]);
+    } else {
+        for(int i = 0; i < graph->numNodes; i++) {
+            memcpy(&NodeTreePositions[(size_t)i * 3], graph->nodes[i].position, 3 * sizeof(float));
+        }
+    }
+    const float *positions = NodeTreePositions.empty() ? NULL : &NodeTreePositions[0];
+    if(NodeTreeLevel == Game.currentLevel && NodeTree.numItems == graph->numNodes) {
+        refitNodeBvh(&NodeTree, positions);
+    } else {
+        buildNodeBvh(&NodeTree, positions, graph->numNodes, 0.1f);
+        NodeTreeLevel = Game.currentLevel;
     }
 }
 
-// Function to perform picking
-void pickNode(int x, int y) {
-    GLuint selectBuf[512];
-    GLint hits;
-    GLint viewport[4];
+// Draw the nodes of graph where NodeTree has them.  With NodeCullingOn,
+// nodes outside the view frustum are skipped and each of the rest gets the
+// coarsest tessellation that still looks round at its size on screen;
+// the smallest become points.  Must be called with the scene's projection
+// and modelview matrices current.
+void drawNodes(Graph *graph) {
+    if(NodeTreeLevel != Game.currentLevel) {
+        updateNodeTree();
+    }
 
+    GLfloat modelview[16], projection[16], clip[16];
+    GLint viewport[4];
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
     glGetIntegerv(GL_VIEWPORT, viewport);
+    for(int c = 0; c < 4; c++) {
+        for(int r = 0; r < 4; r++) {
+            clip[4 * c + r] = projection[r] * modelview[4 * c] + projection[4 + r] * modelview[4 * c + 1] +
+                              projection[8 + r] * modelview[4 * c + 2] + projection[12 + r] * modelview[4 * c + 3];
+        }
+    }
 
-    glSelectBuffer(512, selectBuf);
-    glRenderMode(GL_SELECT);
-
-    glInitNames();
-    glPushName(0);
-
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-        glLoadIdentity();
-        gluPickMatrix((GLdouble)x, (GLdouble)(viewport[3] - y), 5.0, 5.0, viewport);
-        gluPerspective(70.f, 1.f, 0.1f, 1000.f);
+    VisibleNodes.clear();
+    if(NodeCullingOn) {
+        // frustum planes in model space, from the rows of projection * modelview
+        float planes[6][4];
+        for(int k = 0; k < 6; k++) {
+            int row = k / 2;
+            float sign = (k % 2 == 0) ? 1.f : -1.f;
+            for(int j = 0; j < 4; j++) {
+                planes[k][j] = clip[4 * j + 3] + sign * clip[4 * j + row];
+            }
+        }
+        bvhQueryFrustum(&NodeTree, planes, 6, &VisibleNodes);
+    } else {
+        VisibleNodes.resize(graph->numNodes);
+        for(int i = 0; i < graph->numNodes; i++) VisibleNodes[i] = i;
+    }
 
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
+    // a node's on-screen radius in pixels is pixelScale / (its clip w)
+    float pixelScale = 0.1f * Scale * projection[5] * 0.5f * (float)viewport[3];
+    for(int lod = 0; lod <= NODE_LODS; lod++) {
+        NodeInstanceData[lod].clear();
+    }
+    for(size_t k = 0; k < VisibleNodes.size(); k++) {
+        int i = VisibleNodes[k];
+        const float *p = &NodeTree.positions[(size_t)i * 3];
+        int lod = 0;
+        if(NodeCullingOn) {
+            float w = clip[3] * p[0] + clip[7] * p[1] + clip[11] * p[2] + clip[15];
+            float pixels = w > 0.f ? pixelScale / w : 1e9f;
+            while(lod < NODE_LODS && pixels < NODE_LOD_MIN_PIXELS[lod]) lod++;
+        }
+        std::vector<float> &data = NodeInstanceData[lod];
+        size_t at = data.size();
+        data.resize(at + NODE_INSTANCE_FLOATS);
+        data[at] = p[0];
+        data[at + 1] = p[1];
+        data[at + 2] = p[2];
+        nodeDrawColor(graph->nodes[i], &data[at + 3]);
+    }
 
-        // Use the same camera setup as in Display()
-        float currentCameraY;
-        if(inTransition) {
-            float t = transitionTime / TRANSITION_DURATION;
-            if(t > 1.0f) t = 1.0f;
-            currentCameraY = StartCameraY + (EndCameraY - StartCameraY) * t;
+    for(int lod = 0; lod < NODE_LODS; lod++) {
+        std::vector<float> &data = NodeInstanceData[lod];
+        int count = (int)(data.size() / NODE_INSTANCE_FLOATS);
+        if(count == 0) continue;
+        if(InstancedNodesOn && NodeSpheres.supported && NodeLodMeshes[lod] >= 0) {
+            DrawNodeInstances(&NodeSpheres, NodeLodMeshes[lod], &data[0], count);
         } else {
-            currentCameraY = CameraY;
+            for(int n = 0; n < count; n++) {
+                const float *instance = &data[(size_t)n * NODE_INSTANCE_FLOATS];
+                glPushMatrix();
+                    glTranslatef(instance[0], instance[1], instance[2]);
+                    glColor3fv(&instance[3]);
+                    glCallList(sphereLodLists[lod]);
+                glPopMatrix();
+                CountDraw(2 * (NODE_LOD_SLICES[lod] + 1) * NODE_LOD_SLICES[lod]);
+            }
         }
+    }
 
-        // Match the Display function's camera setup exactly
-        gluLookAt(0.0f, currentCameraY, 3.0f,     // eye position
-                  0.f, 0.f, 0.f,                   // look-at point
-                  0.f, 1.f, 0.f);                  // up vector
-
-        // Apply the same transformations as in Display
-        glRotatef((GLfloat)Yrot, 0.f, 1.f, 0.f);
-        glRotatef((GLfloat)Xrot, 1.f, 0.f, 0.f);
-        glScalef((GLfloat)Scale, (GLfloat)Scale, (GLfloat)Scale);
-
-        // Draw nodes with unique names
-        Graph currentGraph = levels[currentLevel];
-        for(int i = 0; i < currentGraph.numNodes; i++) {
-            glLoadName(currentGraph.nodes[i].id);
-            glPushMatrix();
-                if(inTransition) {
-                    float t = transitionTime / TRANSITION_DURATION;
-                    if(t > 1.0f) t = 1.0f;
-                    float x = xPos[i].GetValue(t);
-                    float y = yPos[i].GetValue(t);
-                    float z = zPos[i].GetValue(t);
-                    glTranslatef(x, y, z);
-                } else {
-                    glTranslatef(currentGraph.nodes[i].position[0], 
-                               currentGraph.nodes[i].position[1], 
-                               currentGraph.nodes[i].position[2]);
-                }
-                glutSolidSphere(0.1, 20, 20);
-            glPopMatrix();
+    // far nodes: round points, sized by distance to the same width as the sphere
+    std::vector<float> &points = NodeInstanceData[NODE_LODS];
+    if(!points.empty()) {
+        GLfloat attenuation[3] = { 1.f, 0.f, 0.f };
+        if(NowProjection == PERSP) {
+            attenuation[0] = 0.f;
+            attenuation[2] = 1.f;       // size / distance
         }
+        GLfloat noAttenuation[3] = { 1.f, 0.f, 0.f };
+        GLsizei stride = NODE_INSTANCE_FLOATS * sizeof(float);
+        glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT);
+        glDisable(GL_LIGHTING);
+        glEnable(GL_POINT_SMOOTH);
+        glPointSize(2.f * pixelScale);
+        glPointParameterfv(GL_POINT_DISTANCE_ATTENUATION, attenuation);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(3, GL_FLOAT, stride, &points[0]);
+        glColorPointer(3, GL_FLOAT, stride, &points[3]);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)(points.size() / NODE_INSTANCE_FLOATS));
+        CountDraw(points.size() / NODE_INSTANCE_FLOATS);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glPointParameterfv(GL_POINT_DISTANCE_ATTENUATION, noAttenuation);
+        glPopAttrib();
+    }
+}
 
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-
-    hits = glRenderMode(GL_RENDER);
-    if(hits > 0) {
-        GLuint *ptr = selectBuf;
-        GLuint minZ = 0xFFFFFFFF;
-        int selected = -1;
-        for(int i = 0; i < hits; i++) {
-            int numNames = ptr[0];
-            GLuint z1 = ptr[1];
-            for(int j = 0; j < numNames; j++) {
-                if(z1 < minZ) {
-                    minZ = z1;
-                    selected = ptr[3 + j];
-                }
-            }
-            ptr += 3 + ptr[0];
-        }
-        selectedNode = selected;
+void drawText(const char *text, float x, float y, float z) {
+    if(Headless) return;    // GLUT fonts need glutInit()
+    glRasterPos3f(x, y, z);
+    for(const char *c = text; *c != '\0'; c++) {
+        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
+    }
+}
 
+// Ray through window pixel (x, y), in the model space the nodes are drawn in.
+// Mirrors the viewport, projection and camera set up in Display().
+void pickRay(int x, int y, float origin[3], float dir[3]) {
+    int vx = glutGet(GLUT_WINDOW_WIDTH);
+    int vy = glutGet(GLUT_WINDOW_HEIGHT);
+    int v = vx < vy ? vx : vy;
+    float nx = 2.f * ((float)x + 0.5f - (float)((vx - v) / 2)) / (float)v - 1.f;
+    float ny = 2.f * ((float)(vy - y) - 0.5f - (float)((vy - v) / 2)) / (float)v - 1.f;
+
+    // eye space
+    float eyeOrigin[3], eyeDir[3];
+    if(NowProjection == ORTHO) {
+        eyeOrigin[0] = 2.f * nx;  eyeOrigin[1] = 2.f * ny;  eyeOrigin[2] = 0.f;
+        eyeDir[0] = 0.f;  eyeDir[1] = 0.f;  eyeDir[2] = -1.f;
     } else {
-        selectedNode = -1;
+        float tanHalf = tanf(35.f * F_PI / 180.f);
+        eyeOrigin[0] = eyeOrigin[1] = eyeOrigin[2] = 0.f;
+        eyeDir[0] = nx * tanHalf;  eyeDir[1] = ny * tanHalf;  eyeDir[2] = -1.f;
+    }
+
+    // world space: undo gluLookAt(0, cameraY, 3,  0, 0, 0,  0, 1, 0)
+    float cameraY = CameraY;
+    if(inTransition) {
+        float t = transitionTime / TRANSITION_DURATION;
+        if(t > 1.0f) t = 1.0f;
+        cameraY = StartCameraY + (EndCameraY - StartCameraY) * t;
+    }
+    float eye[3] = { 0.f, cameraY, 3.f };
+    float len = sqrtf(eye[1] * eye[1] + eye[2] * eye[2]);
+    float f[3] = { 0.f, -eye[1] / len, -eye[2] / len };     // forward
+    float side[3] = { 1.f, 0.f, 0.f };                      // forward x up, normalized
+    float up[3] = { 0.f, -f[2], f[1] };                     // side x forward
+    float worldOrigin[3], worldDir[3];
+    for(int a = 0; a < 3; a++) {
+        worldOrigin[a] = eye[a] + side[a] * eyeOrigin[0] + up[a] * eyeOrigin[1] - f[a] * eyeOrigin[2];
+        worldDir[a] = side[a] * eyeDir[0] + up[a] * eyeDir[1] - f[a] * eyeDir[2];
+    }
+
+    // model space: undo glRotatef(Yrot, y), glRotatef(Xrot, x), glScalef(Scale)
+    float cy = cosf(-Yrot * F_PI / 180.f), sy = sinf(-Yrot * F_PI / 180.f);
+    float cx = cosf(-Xrot * F_PI / 180.f), sx = sinf(-Xrot * F_PI / 180.f);
+    float *in[2] = { worldOrigin, worldDir };
+    float *out[2] = { origin, dir };
+    for(int k = 0; k < 2; k++) {
+        float *p = in[k];
+        float x1 = cy * p[0] + sy * p[2], y1 = p[1], z1 = -sy * p[0] + cy * p[2];
+        float x2 = x1, y2 = cx * y1 - sx * z1, z2 = sx * y1 + cx * z1;
+        out[k][0] = x2 / Scale;
+        out[k][1] = y2 / Scale;
+        out[k][2] = z2 / Scale;
     }
+}
+
+// Function to perform picking
+// Casts a ray through the clicked pixel against the node spheres on the CPU
+void pickNode(int x, int y) {
+    Graph *graph = &levels[Game.currentLevel];
+
+    // nothing can be colored until the next level is in place
+    if(inTransition) {
+        return;
+    }
+
+    if(NodeTreeLevel != Game.currentLevel) {
+        updateNodeTree();
+    }
+
+    float origin[3], dir[3];
+    pickRay(x, y, origin, dir);
+    int hit = bvhRayNearest(&NodeTree, origin, dir);
+    int selected = hit >= 0 ? graph->nodes[hit].id : -1;
 
-    glutPostRedisplay();
+    // a click that leaves the selection as it was needs no new frame
+    if(selected != Game.selectedNode) {
+        Game.selectedNode = selected;
+        PostRedraw();
+    }
+}
+
+// CPU seconds this process has used, user and system, on every thread
+double ProcessCpuSeconds() {
+#ifdef WIN32
+    FILETIME created, exited, kernel, user;
+    if(!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) return 0.0;
+    // FILETIMEs count 100 ns ticks
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return 1e-7 * (double)(k.QuadPart + u.QuadPart);
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return (double)usage.ru_utime.tv_sec + 1e-6 * usage.ru_utime.tv_usec +
+           (double)usage.ru_stime.tv_sec + 1e-6 * usage.ru_stime.tv_usec;
+#endif
 }
 
 void cleanup() {
-    for(int i = 0; i < NUM_LEVELS; i++) {
-        free(levels[i].nodes);
-        free(levels[i].edges);
-    }
+    freeLevels();
+
+    // how much of a core the game kept busy, idle time included
+    double wall = ElapsedSeconds();
+    double cpu = ProcessCpuSeconds();
+    printf("CPU %.2f s in %.1f s (%.1f%% of one core)\n", cpu, wall, wall > 0.0 ? 100.0 * cpu / wall : 0.0);
+    printf("Frames drawn %lld, needed %lld (%lld redraw requests)\n",
+           RedrawStats.rendered, RedrawStats.needed, RedrawStats.requests);
 }
 
 
@@ -739,7 +1113,18 @@ main( int argc, char *argv[ ] )
 	// (do this before checking argc and argv since glutInit might
 	// pull some command line arguments out)
 
+#ifdef HEADLESS
+	// render offscreen and time it instead of opening a window
+	if( argc > 1 && strcmp( argv[1], "--headless" ) == 0 )
+		return RunHeadless( argc, argv );
+#endif
+
 	glutInit( &argc, argv );
+	initAnimationClock( &TransitionClock, ANIMATION_STEP, ANIMATION_MAX_STEPS );
+
+	// whatever glutInit( ) did not consume names a level pack or graph file
+	if( argc > 1 )
+		LevelFilePath = argv[1];
 
 	// setup all the graphics stuff:
 
@@ -774,47 +1159,96 @@ main( int argc, char *argv[ ] )
 }
 
 
-// this is where one would put code that is to be called
-// everytime the glut main loop has nothing to do
-//
-// this is typically where animation parameters are set
+// mark the scene as changed and have glut draw it once when it is next idle:
+// every redraw goes through here, so a static board draws no frames at all
+
+void
+PostRedraw( )
+{
+	SceneDirty = true;
+	RedrawStats.requests++;
+	if( Headless )
+		return;
+	glutSetWindow( MainWindow );
+	glutPostRedisplay( );
+}
+
+
+// start stepping the animation in wall-clock time:
+// arms AnimationTimer( ) unless it is already pending
+
+void
+StartAnimation( )
+{
+	startAnimationClock( &TransitionClock, ElapsedSeconds( ) );
+	if( Headless || AnimationTimerArmed )
+		return;
+	AnimationTimerArmed = true;
+	glutTimerFunc( 0, AnimationTimer, 0 );
+}
+
+
+// glut timer callback: run the animation steps that are due, then sleep
+// until the next one -- or not at all if nothing is animating any more
+
+void
+AnimationTimer( int value )
+{
+	AnimationTimerArmed = false;
+	Animate( );
+
+	if( TransitionClock.running )
+	{
+		int ms = (int)ceil( 1000. * secondsToNextStep( &TransitionClock, ElapsedSeconds( ) ) );
+		AnimationTimerArmed = true;
+		glutTimerFunc( ms, AnimationTimer, 0 );
+	}
+}
+
+
+// advance the animations by the fixed steps that have come due:
+// the transition takes TRANSITION_DURATION seconds of wall-clock time
+// however fast or slow the event loop is
 //
-// do not call Display( ) from here -- let glutPostRedisplay( ) do it
+// do not call Display( ) from here -- let PostRedraw( ) ask for it
 
 void
 Animate( )
 {
 	// put animation stuff in here -- change some global variables for Display( ) to find:
 
-	int ms = glutGet(GLUT_ELAPSED_TIME);
-	ms %= MS_PER_CYCLE;							// makes the value of ms between 0 and MS_PER_CYCLE-1
+	float now = ElapsedSeconds( );
+	int ms = (int)( 1000.f * now ) % MS_PER_CYCLE;	// makes the value of ms between 0 and MS_PER_CYCLE-1
 	Time = (float)ms / (float)MS_PER_CYCLE;		// makes the value of Time between 0. and slightly less than 1.
 
+	int steps = advanceAnimationClock( &TransitionClock, now );
+	if( steps == 0 )
+		return;
+
 	if(inTransition) {
-        transitionTime += 1.0f/60.0f;  
+        transitionTime += steps * ANIMATION_STEP;
+        updateNodeTree();   // the nodes moved
         
         if(transitionTime >= TRANSITION_DURATION) {
             // Transition complete
             inTransition = false;
             edgesVisible = true;
-            currentLevel++;  // Now advance to next level
+            advanceLevel(&Game);  // Now advance to next level, with its colors cleared
 			CameraY = EndCameraY;  // Keep camera at end position
 
-            printf("Transition complete, moving to level %d\n", currentLevel);
-            
-            // Reset node colors for new level
-            for(int i = 0; i < levels[currentLevel].numNodes; i++) {
-                levels[currentLevel].nodes[i].color = -1;
-            }
+            printf("Transition complete, moving to level %d\n", Game.currentLevel);
         }
     }
 
+	// nothing left to animate: let the timer lapse
+	if( !inTransition )
+		stopAnimationClock( &TransitionClock );
+
 	// for example, if you wanted to spin an object in Display( ), you might call: glRotatef( 360.f*Time,   0., 1., 0. );
 
-	// force a call to Display( ) next time it is convenient:
+	// the transition moved the nodes: draw them there next time it is convenient
 
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	PostRedraw( );
 }
 
 
@@ -826,9 +1260,37 @@ Display( )
 	if (DebugOn != 0)
 		fprintf(stderr, "Starting Display.\n");
 
+	// frames glut asks for on its own (window exposed) are not marked dirty
+	RedrawStats.rendered++;
+	if( SceneDirty )
+		RedrawStats.needed++;
+	SceneDirty = false;
+
 	// set which window we want to do the graphics into:
 	glutSetWindow( MainWindow );
 
+	RenderScene( glutGet( GLUT_WINDOW_WIDTH ), glutGet( GLUT_WINDOW_HEIGHT ) );
+
+	// swap the double-buffered framebuffers:
+
+	glutSwapBuffers( );
+
+	// be sure the graphics buffer has been sent:
+	// note: be sure to use glFlush( ) here, not glFinish( ) !
+
+	glFlush( );
+}
+
+
+// draw the scene into a vx x vy framebuffer:
+// everything Display( ) does except talking to the window
+
+void
+RenderScene( int vx, int vy )
+{
+	FrameStats.drawCalls = 0;
+	FrameStats.vertices = 0;
+
 	// erase the background:
 	glDrawBuffer( GL_BACK );
 	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
@@ -846,8 +1308,6 @@ Display( )
 
 	// set the viewport to be a square centered in the window:
 
-	GLsizei vx = glutGet( GLUT_WINDOW_WIDTH );
-	GLsizei vy = glutGet( GLUT_WINDOW_HEIGHT );
 	GLsizei v = vx < vy ? vx : vy;			// minimum dimension
 	GLint xl = ( vx - v ) / 2;
 	GLint yb = ( vy - v ) / 2;
@@ -871,7 +1331,7 @@ Display( )
 	glLoadIdentity( );
 
 	// Check for game completion before regular rendering
-    if(gameCompleted) {
+    if(Game.gameCompleted) {
         // Position the camera for the victory text
         gluLookAt(0.0f, 0.0f, 2.5f,     // eye position
                   0.f, 0.f, 0.f,         // look-at point
@@ -992,47 +1452,15 @@ glLightfv(GL_LIGHT0, GL_AMBIENT, ambient_light);
 
 
 
-    // Retrieve the current graph
-    Graph currentGraph = levels[currentLevel];
-	//printf("Drawing %d nodes in level %d\n", currentGraph.numNodes, currentLevel);
 	 glDisable(GL_LIGHTING);
 
     // Draw edges first
-    for(int i = 0; i < currentGraph.numEdges; i++) {
-        drawEdge(currentGraph.edges[i], currentGraph);
+    if(edgesVisible) {
+        DrawEdgeBuffer(&EdgeLines, &levels[Game.currentLevel]);
     }
 
-     // Draw nodes
     // Draw nodes
-	for(int i = 0; i < currentGraph.numNodes; i++) {
-    Node node = currentGraph.nodes[i];
-    glPushMatrix();
-        if(inTransition) {
-            // Calculate normalized time (0 to 1)
-            float t = transitionTime / TRANSITION_DURATION;
-            if(t > 1.0f) t = 1.0f;
-            
-            // Get interpolated positions
-            float x = xPos[i].GetValue(t);
-            float y = yPos[i].GetValue(t);
-            float z = zPos[i].GetValue(t);
-            glTranslatef(x, y, z);
-        } else {
-            glTranslatef(node.position[0], node.position[1], node.position[2]);
-        }
-        
-        // Set color based on node state
-        if(node.color >= 0 && node.color < MAX_COLORS) {
-            glColor3fv(Colors[node.color]);
-        } else if(node.id == selectedNode) {
-            glColor3f(0.3f, 0.3f, 0.3f);  
-        } else {
-            glColor3f(1.0f, 1.0f, 1.0f);  // White for uncolored
-        }
-        
-        glCallList(sphereList);
-    glPopMatrix();
-}
+    drawNodes(drawnGraph());
 
 	// Overlay text (Level and Score)
     glMatrixMode(GL_PROJECTION);
@@ -1052,9 +1480,9 @@ glLightfv(GL_LIGHT0, GL_AMBIENT, ambient_light);
 
         // Display level and score
         char info[50];
-        sprintf(info, "Level: %d", currentLevel + 1);
+        sprintf(info, "Level: %d", Game.currentLevel + 1);
         drawText(info, 5.0f, 95.0f, 0.0f);
-        sprintf(info, "Score: %d", score);
+        sprintf(info, "Score: %d", Game.score);
         drawText(info, 5.0f, 90.0f, 0.0f);
 
         // Re-enable lighting and depth testing
@@ -1105,25 +1533,108 @@ glLightfv(GL_LIGHT0, GL_AMBIENT, ambient_light);
 	glLoadIdentity( );
 	glColor3f( 1.f, 1.f, 1.f );
 	//DoRasterString( 5.f, 5.f, 0.f, (char *)"Text That Doesn't" );
+}
 
-	// swap the double-buffered framebuffers:
 
-	glutSwapBuffers( );
+#ifdef HEADLESS
 
-	// be sure the graphics buffer has been sent:
-	// note: be sure to use glFlush( ) here, not glFinish( ) !
+// color_game --headless [frames [level-file]]
+// render the first level offscreen along a fixed camera path and report
+// frame-time percentiles, draw calls and vertices per frame:
+// returns non-zero if the context cannot be made or the GL reports an error
 
-	glFlush( );
+int
+RunHeadless( int argc, char *argv[ ] )
+{
+	const int HEADLESS_SIZE = 800;
+	int frames = argc > 2 ? atoi( argv[2] ) : 300;
+	if( frames < 1 )
+		frames = 1;
+	if( argc > 3 )
+		LevelFilePath = argv[3];
+
+	Headless = true;
+	if( !CreateHeadlessContext( HEADLESS_SIZE, HEADLESS_SIZE ) )
+		return 1;
+
+#ifndef __APPLE__
+	// glew may only know how to ask glX about extensions, but it loads
+	// the core entry points before finding that out
+	GLenum err = glewInit( );
+	if( err != GLEW_OK
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	    && err != GLEW_ERROR_NO_GLX_DISPLAY
+#endif
+	  )
+	{
+		fprintf( stderr, "glewInit Error\n" );
+		return 1;
+	}
+#endif
+
+	glClearColor( BACKCOLOR[0], BACKCOLOR[1], BACKCOLOR[2], BACKCOLOR[3] );
+	glEnable(GL_COLOR_MATERIAL);
+	glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
+	InitLists( );
+	Reset( );
+
+	// one turn around the graph while zooming out to 0.25 and back to 2
+	std::vector<double> frameMs( frames );
+	double firstMs = 0.;
+	long long drawCalls = 0, vertices = 0;
+	for( int f = -1; f < frames; f++ )
+	{
+		float t = f < 0 ? 0.f : (float)f / (float)frames;
+		Yrot = 360.f * t;
+		Xrot = 30.f * sinf( F_2_PI * t );
+		Scale = 0.25f + 1.75f * ( 0.5f - 0.5f * cosf( F_2_PI * t ) );
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+		RenderScene( HEADLESS_SIZE, HEADLESS_SIZE );
+		glFinish( );
+		double ms = 1000. * std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+
+		// the first frame uploads the level's buffers, so it is reported on its own
+		if( f < 0 )
+		{
+			firstMs = ms;
+			continue;
+		}
+		frameMs[f] = ms;
+		drawCalls += FrameStats.drawCalls;
+		vertices += FrameStats.vertices;
+	}
+
+	GLenum glErr = glGetError( );
+	std::vector<double> sorted( frameMs );
+	std::sort( sorted.begin( ), sorted.end( ) );
+	double total = 0.;
+	for( int f = 0; f < frames; f++ )
+		total += frameMs[f];
+	int p99 = (int)ceil( 0.99 * frames ) - 1;
+
+	printf( "Headless: %d frames at %dx%d, level 1: %d nodes, %d edges\n", frames, HEADLESS_SIZE, HEADLESS_SIZE,
+		levels[0].numNodes, levels[0].numEdges );
+	printf( "frame ms:  p50 %.3f  p99 %.3f  max %.3f  mean %.3f  (first frame %.3f)\n",
+		sorted[frames / 2], sorted[p99 < 0 ? 0 : p99], sorted[frames - 1], total / frames, firstMs );
+	printf( "per frame: %.1f draw calls, %.0f vertices\n", (double)drawCalls / frames, (double)vertices / frames );
+	if( glErr != GL_NO_ERROR )
+	{
+		fprintf( stderr, "GL error 0x%x during the run\n", glErr );
+		return 1;
+	}
+	return 0;
 }
 
+#endif
+
 
 void
 DoAxesMenu( int id )
 {
 	AxesOn = id;
 
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	PostRedraw( );
 }
 
 
@@ -1132,8 +1643,7 @@ DoColorMenu( int id )
 {
 	NowColor = id - RED;
 
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	PostRedraw( );
 }
 
 
@@ -1142,8 +1652,7 @@ DoDebugMenu( int id )
 {
 	DebugOn = id;
 
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	PostRedraw( );
 }
 
 
@@ -1152,8 +1661,7 @@ DoDepthBufferMenu( int id )
 {
 	DepthBufferOn = id;
 
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	PostRedraw( );
 }
 
 
@@ -1162,8 +1670,7 @@ DoDepthFightingMenu( int id )
 {
 	DepthFightingOn = id;
 
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	PostRedraw( );
 }
 
 
@@ -1172,8 +1679,7 @@ DoDepthMenu( int id )
 {
 	DepthCueOn = id;
 
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	PostRedraw( );
 }
 
 
@@ -1202,8 +1708,7 @@ DoMainMenu( int id )
 			fprintf( stderr, "Don't know what to do with Main Menu ID %d\n", id );
 	}
 
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	PostRedraw( );
 }
 
 
@@ -1212,8 +1717,7 @@ DoProjectMenu( int id )
 {
 	NowProjection = id;
 
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	PostRedraw( );
 }
 
 
@@ -1256,8 +1760,14 @@ float
 ElapsedSeconds( )
 {
 	// get # of milliseconds since the start of the program:
+	// (there is no glut to ask when running headless)
 
-	int ms = glutGet( GLUT_ELAPSED_TIME );
+	static std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+	int ms;
+	if( Headless )
+		ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now( ) - start ).count( );
+	else
+		ms = glutGet( GLUT_ELAPSED_TIME );
 
 	// convert it to seconds:
 
@@ -1397,16 +1907,16 @@ InitGraphics( )
 	glutMenuStateFunc( NULL );
 	glutTimerFunc( -1, NULL, 0 );
 
-	// setup glut to call Animate( ) every time it has
-	// 	nothing it needs to respond to (which is most of the time)
-	// we don't need to do this for this program, and really should set the argument to NULL
-	// but, this sets us up nicely for doing animation
+	// nothing runs when glut has nothing to respond to:
+	// animations are stepped by AnimationTimer( ), which StartAnimation( )
+	// arms and which stops re-arming itself when they are done,
+	// so a static board leaves the process asleep
 
-	glutIdleFunc( Animate );
+	glutIdleFunc( NULL );
 
 	// init the glew package (a window must be open to do this):
 
-#ifdef WIN32
+#ifndef __APPLE__
 	GLenum err = glewInit( );
 	if( err != GLEW_OK )
 	{
@@ -1437,7 +1947,8 @@ InitLists( )
 	float dx = BOXSIZE / 2.f;
 	float dy = BOXSIZE / 2.f;
 	float dz = BOXSIZE / 2.f;
-	glutSetWindow( MainWindow );
+	if( !Headless )
+		glutSetWindow( MainWindow );
 
 	// create the object:
 
@@ -1492,10 +2003,26 @@ InitLists( )
 
 	glEndList( );
 	
-	sphereList = glGenLists(1);
-    glNewList(sphereList, GL_COMPILE);
-		glutSolidSphere(0.1, 20, 20);
-    glEndList( );
+	// one node sphere per level of detail, finest first
+	// (glu rather than glut spheres, so these also work headless)
+	GLUquadric *quadric = gluNewQuadric( );
+	for( int lod = 0; lod < NODE_LODS; lod++ )
+	{
+		sphereLodLists[lod] = glGenLists(1);
+		glNewList(sphereLodLists[lod], GL_COMPILE);
+			gluSphere(quadric, 0.1, NODE_LOD_SLICES[lod], NODE_LOD_SLICES[lod]);
+		glEndList( );
+	}
+	gluDeleteQuadric( quadric );
+	sphereList = sphereLodLists[0];
+
+	// the same spheres as instanced meshes, for drawing each LOD's nodes in one call
+	InitNodeInstancer(&NodeSpheres, 0.1f);
+	for( int lod = 0; lod < NODE_LODS; lod++ )
+		NodeLodMeshes[lod] = AddNodeInstancerMesh(&NodeSpheres, NODE_LOD_SLICES[lod], NODE_LOD_SLICES[lod]);
+
+	// the buffers every edge is drawn from
+	InitEdgeBuffer(&EdgeLines);
 
 	textDisplayList = glGenLists(1);
     glNewList(textDisplayList, GL_COMPILE);
@@ -1505,7 +2032,7 @@ InitLists( )
             glTranslatef(-1500.0f, 0.0f, 0.0f);  // Center the text
             
             // Draw each character of the text
-            for(const char* c = VICTORY_TEXT; *c != '\0'; c++) {
+            for(const char* c = VICTORY_TEXT; *c != '\0' && !Headless; c++) {
                 glutStrokeCharacter(GLUT_STROKE_ROMAN, *c);
             }
         glPopMatrix();
@@ -1536,86 +2063,82 @@ Keyboard( unsigned char c, int x, int y )
 		case 'n':
         case 'N':
             // Reset everything to starting state
-            currentLevel = 0;
-            score = 0;
-            moves = 0;
-            selectedNode = -1;
-            // Reset colors for all nodes in all levels
-            for(int l = 0; l < NUM_LEVELS; l++) {
-                for(int n = 0; n < levels[l].numNodes; n++) {
-                    levels[l].nodes[n].color = -1;
-                }
-            }
             Reset();
+            PostRedraw();
             break;
 
 		case 'r':
         case 'R':
-            if(selectedNode != -1) {
-                levels[currentLevel].nodes[selectedNode].color = RED;
-				moves++;
-        		provideFeedback(); 
-                glutPostRedisplay();
-            }
+            colorSelectedNode(RED);
             break;
 
         case 'y':
         case 'Y':
-            if(selectedNode != -1) {
-                levels[currentLevel].nodes[selectedNode].color = YELLOW;
-				moves++;
-        		provideFeedback(); 
-                glutPostRedisplay();
-            }
+            colorSelectedNode(YELLOW);
             break;
 
         case 'g':
         case 'G':
-            if(selectedNode != -1) {
-                levels[currentLevel].nodes[selectedNode].color = GREEN;
-				moves++;
-        		provideFeedback(); 
-                glutPostRedisplay();
-            }
+            colorSelectedNode(GREEN);
             break;
 
         case 'c':
         case 'C':
-            if(selectedNode != -1) {
-                levels[currentLevel].nodes[selectedNode].color = CYAN;
-				moves++;
-        		provideFeedback(); 
-                glutPostRedisplay();
-            }
+            colorSelectedNode(CYAN);
             break;
 
         case 'b':
         case 'B':
-            if(selectedNode != -1) {
-                levels[currentLevel].nodes[selectedNode].color = BLUE;
-				moves++;
-        		provideFeedback(); 
-                glutPostRedisplay();
-            }
+            colorSelectedNode(BLUE);
             break;
 
         case 'm':
         case 'M':
-            if(selectedNode != -1) {
-                levels[currentLevel].nodes[selectedNode].color = MAGENTA;
-				moves++;
-        		provideFeedback(); 
-                glutPostRedisplay();
-            }
+            colorSelectedNode(MAGENTA);
+            break;
+
+        case 'z':
+        case 'Z':
+            stepJournal(0);     // undo
+            break;
+
+        case 'x':
+        case 'X':
+            stepJournal(1);     // redo
             break;
+
+        case 'h':
+        case 'H':
+            // select a node that can be colored without getting stuck
+            showHint();
+            break;
+
+		case 'i':
+		case 'I':
+			// switch between instanced and per-node sphere drawing
+			InstancedNodesOn = !InstancedNodesOn;
+			printf("Instanced node drawing %s\n", InstancedNodesOn && NodeSpheres.supported ? "on" : "off");
+			PostRedraw( );
+			break;
+
+		case 'l':
+		case 'L':
+			// switch frustum culling and level of detail on and off
+			NodeCullingOn = !NodeCullingOn;
+			printf("Node culling and LOD %s\n", NodeCullingOn ? "on" : "off");
+			PostRedraw( );
+			break;
+
 		case 'o':
 		case 'O':
 			NowProjection = ORTHO;
+			PostRedraw( );
 			break;
 
 		case 'p':
 		case 'P':
 			NowProjection = PERSP;
+			PostRedraw( );
 			break;
 
 		case 'q':
@@ -1628,10 +2151,7 @@ Keyboard( unsigned char c, int x, int y )
 			fprintf( stderr, "Don't know what to do with keyboard hit: '%c' (0x%0x)\n", c, c );
 	}
 
-	// force a call to Display( ):
-
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	// each case that changes the scene asks for its own redraw
 }
 
 
@@ -1647,9 +2167,7 @@ MouseButton( int button, int state, int x, int y )
 
     // Do not handle other buttons or scroll wheel
     // This effectively disables rotation, scaling, and any other mouse-based manipulations
-
-    glutSetWindow(MainWindow);
-    glutPostRedisplay();
+    // pickNode( ) asks for a redraw if the selection changed
 }
 
 
@@ -1661,6 +2179,7 @@ MouseMotion( int x, int y )
 {
 	int dx = x - Xmouse;		// change in mouse coords
 	int dy = y - Ymouse;
+	float oldXrot = Xrot, oldYrot = Yrot, oldScale = Scale;
 
 	if( ( ActiveButton & LEFT ) != 0 )
 	{
@@ -1681,8 +2200,9 @@ MouseMotion( int x, int y )
 	Xmouse = x;			// new current position
 	Ymouse = y;
 
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	// passive motion (no button down) moves nothing on screen
+	if( Xrot != oldXrot || Yrot != oldYrot || Scale != oldScale )
+		PostRedraw( );
 }
 
 
@@ -1705,18 +2225,24 @@ Reset( )
 	NowProjection = PERSP;
 	Xrot = Yrot = 0.;
 	CameraY = StartCameraY;  // Reset camera Y position
-	gameCompleted = false;
-    currentLevel = 0;
-    score = 0;
-    moves = 0;
-    
-
-
-	initializeLevels();
+	// drop any transition in progress; the game goes back to the first level
+	inTransition = false;
+	edgesVisible = true;
+	transitionTime = 0.0f;
+	stopAnimationClock( &TransitionClock );
+	NodeTreeLevel = -1;
+
+
+	// load the levels the first time only: their color targets took the
+	// search seconds to find, and a new game on them only clears the colors
+	if( levels == NULL )
+		initializeLevels( );
+	else
+		resetGame( &Game );
 
 	// Add some debug output
     printf("Reset called, initialized %d nodes in level %d\n", 
-           levels[currentLevel].numNodes, currentLevel);
+           levels[Game.currentLevel].numNodes, Game.currentLevel);
 }
 
 
@@ -1728,8 +2254,7 @@ Resize( int width, int height )
 	// don't really need to do anything since window size is
 	// checked each time in Display( ):
 
-	glutSetWindow( MainWindow );
-	glutPostRedisplay( );
+	PostRedraw( );
 }
 
 
@@ -1743,8 +2268,7 @@ Visibility ( int state )
 
 	if( state == GLUT_VISIBLE )
 	{
-		glutSetWindow( MainWindow );
-		glutPostRedisplay( );
+		PostRedraw( );
 	}
 	else
 	{
@@ -0,0 +1,219 @@
+//	Batched edge lines
+//
+//	Every edge of the level lives in one pair of vertex buffers (positions and
+//	colors, two vertices per edge) that are drawn with a single
+//	glDrawArrays( GL_LINES ).  Positions are uploaded once per level.  Colors
+//	are kept in a CPU copy; each frame only the edges touching a node whose
+//	color changed since the last frame are recolored and sent to the GL.
+//
+//	Uses buffer objects when the GL has them (1.5 and up), otherwise plain
+//	client-side vertex arrays -- still one draw call either way.
+//
+//	Needs graph.cpp and renderstats.cpp to be included first.
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+typedef struct EdgeBuffer {
+    bool useBuffers;            // buffer objects available
+    GLuint positionBuffer;      // xyz per vertex
+    GLuint colorBuffer;         // rgba bytes per vertex
+    // the level the buffers were built for (NULL until the first draw)
+    const Graph *graph;
+    const Node *nodes;
+    const Edge *edges;
+    int numNodes;
+    int numEdges;
+    std::vector<float> positions;
+    std::vector<unsigned char> colors;
+    std::vector<int> nodeColors;        // node colors the color buffer was built from
+    std::vector<int> incidentOffsets;   // edges touching node i are
+    std::vector<int> incidentEdges;     //   incidentEdges[incidentOffsets[i] .. incidentOffsets[i+1]-1]
+    std::vector<int> dirtyEdges;
+} EdgeBuffer;
+
+static const unsigned char EDGE_NORMAL_COLOR[4]   = { 255, 255, 255, 255 };  // bright white
+static const unsigned char EDGE_CONFLICT_COLOR[4] = { 255,   0,   0, 255 };  // bright red
+
+
+void
+InitEdgeBuffer( EdgeBuffer *buf )
+{
+    buf->graph = NULL;
+    buf->positionBuffer = buf->colorBuffer = 0;
+
+    const char *version = (const char *)glGetString( GL_VERSION );
+    int major = 0, minor = 0;
+    buf->useBuffers = version != NULL && sscanf( version, "%d.%d", &major, &minor ) == 2 &&
+                      ( major > 1 || ( major == 1 && minor >= 5 ) );
+    if( buf->useBuffers )
+    {
+        glGenBuffers( 1, &buf->positionBuffer );
+        glGenBuffers( 1, &buf->colorBuffer );
+    }
+}
+
+
+// Forget the level the buffers were built from.  Call when levels are freed,
+// since a new level could be allocated at the same addresses.
+void
+InvalidateEdgeBuffer( EdgeBuffer *buf )
+{
+    buf->graph = NULL;
+}
+
+
+static inline void
+SetEdgeColor( EdgeBuffer *buf, const Graph *g, int e )
+{
+    int from = g->nodes[ g->edges[e].from ].color;
+    int to = g->nodes[ g->edges[e].to ].color;
+    const unsigned char *rgba = from != -1 && from == to ? EDGE_CONFLICT_COLOR : EDGE_NORMAL_COLOR;
+    memcpy( &buf->colors[ 8 * (size_t)e ], rgba, 4 );
+    memcpy( &buf->colors[ 8 * (size_t)e + 4 ], rgba, 4 );
+}
+
+
+// Fill both buffers from scratch for level g
+static void
+RebuildEdgeBuffer( EdgeBuffer *buf, const Graph *g )
+{
+    buf->graph = g;
+    buf->nodes = g->nodes;
+    buf->edges = g->edges;
+    buf->numNodes = g->numNodes;
+    buf->numEdges = g->numEdges;
+
+    size_t vertices = 2 * (size_t)g->numEdges;
+    buf->positions.resize( 3 * vertices );
+    buf->colors.resize( 4 * vertices );
+    for( int e = 0; e < g->numEdges; e++ )
+    {
+        memcpy( &buf->positions[ 6 * (size_t)e ], g->nodes[ g->edges[e].from ].position, 3 * sizeof(float) );
+        memcpy( &buf->positions[ 6 * (size_t)e + 3 ], g->nodes[ g->edges[e].to ].position, 3 * sizeof(float) );
+        SetEdgeColor( buf, g, e );
+    }
+
+    buf->nodeColors.resize( g->numNodes );
+    for( int i = 0; i < g->numNodes; i++ )
+        buf->nodeColors[i] = g->nodes[i].color;
+
+    // counting sort of edge ids by endpoint, like buildAdjacency( ) but keeping the edge
+    buf->incidentOffsets.assign( g->numNodes + 1, 0 );
+    for( int e = 0; e < g->numEdges; e++ )
+    {
+        buf->incidentOffsets[ g->edges[e].from + 1 ]++;
+        buf->incidentOffsets[ g->edges[e].to + 1 ]++;
+    }
+    for( int i = 0; i < g->numNodes; i++ )
+        buf->incidentOffsets[i + 1] += buf->incidentOffsets[i];
+    buf->incidentEdges.resize( 2 * (size_t)g->numEdges );
+    std::vector<int> next( buf->incidentOffsets.begin( ), buf->incidentOffsets.end( ) - 1 );
+    for( int e = 0; e < g->numEdges; e++ )
+    {
+        buf->incidentEdges[ next[ g->edges[e].from ]++ ] = e;
+        buf->incidentEdges[ next[ g->edges[e].to ]++ ] = e;
+    }
+    buf->dirtyEdges.clear( );
+
+    if( buf->useBuffers && vertices > 0 )
+    {
+        glBindBuffer( GL_ARRAY_BUFFER, buf->positionBuffer );
+        glBufferData( GL_ARRAY_BUFFER, buf->positions.size( ) * sizeof(float), &buf->positions[0], GL_STATIC_DRAW );
+        glBindBuffer( GL_ARRAY_BUFFER, buf->colorBuffer );
+        glBufferData( GL_ARRAY_BUFFER, buf->colors.size( ), &buf->colors[0], GL_DYNAMIC_DRAW );
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    }
+}
+
+
+// Recolor the edges of every node whose color changed since the last call
+// and send just those ranges of the color buffer to the GL
+static void
+PatchEdgeColors( EdgeBuffer *buf, const Graph *g )
+{
+    std::vector<int> &dirty = buf->dirtyEdges;
+    dirty.clear( );
+    for( int i = 0; i < g->numNodes; i++ )
+    {
+        if( g->nodes[i].color == buf->nodeColors[i] )
+            continue;
+        buf->nodeColors[i] = g->nodes[i].color;
+        dirty.insert( dirty.end( ), &buf->incidentEdges[0] + buf->incidentOffsets[i],
+                                    &buf->incidentEdges[0] + buf->incidentOffsets[i + 1] );
+    }
+    if( dirty.empty( ) )
+        return;
+
+    std::sort( dirty.begin( ), dirty.end( ) );
+    dirty.erase( std::unique( dirty.begin( ), dirty.end( ) ), dirty.end( ) );
+    for( size_t k = 0; k < dirty.size( ); k++ )
+        SetEdgeColor( buf, g, dirty[k] );
+
+    if( !buf->useBuffers )
+        return;
+
+    glBindBuffer( GL_ARRAY_BUFFER, buf->colorBuffer );
+    if( dirty.size( ) > (size_t)g->numEdges / 4 )
+    {
+        // most of the level changed (a reset): one upload beats many small ones
+        glBufferSubData( GL_ARRAY_BUFFER, 0, buf->colors.size( ), &buf->colors[0] );
+    }
+    else
+    {
+        // one upload per run of consecutive edges
+        size_t k = 0;
+        while( k < dirty.size( ) )
+        {
+            size_t run = k + 1;
+            while( run < dirty.size( ) && dirty[run] == dirty[run - 1] + 1 )
+                run++;
+            GLintptr offset = 8 * (GLintptr)dirty[k];
+            GLsizeiptr bytes = 8 * (GLsizeiptr)( dirty[run - 1] - dirty[k] + 1 );
+            glBufferSubData( GL_ARRAY_BUFFER, offset, bytes, &buf->colors[ offset ] );
+            k = run;
+        }
+    }
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+
+// Draw every edge of g as GL_LINES in one call, with lighting off
+void
+DrawEdgeBuffer( EdgeBuffer *buf, const Graph *g )
+{
+    if( buf->graph != g || buf->nodes != g->nodes || buf->edges != g->edges ||
+        buf->numNodes != g->numNodes || buf->numEdges != g->numEdges )
+        RebuildEdgeBuffer( buf, g );
+    else
+        PatchEdgeColors( buf, g );
+
+    if( g->numEdges <= 0 )
+        return;
+
+    glDisable( GL_LIGHTING );
+    glLineWidth( 3.0 );
+
+    glEnableClientState( GL_VERTEX_ARRAY );
+    glEnableClientState( GL_COLOR_ARRAY );
+    if( buf->useBuffers )
+    {
+        glBindBuffer( GL_ARRAY_BUFFER, buf->positionBuffer );
+        glVertexPointer( 3, GL_FLOAT, 0, (const GLvoid *)0 );
+        glBindBuffer( GL_ARRAY_BUFFER, buf->colorBuffer );
+        glColorPointer( 4, GL_UNSIGNED_BYTE, 0, (const GLvoid *)0 );
+        glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    }
+    else
+    {
+        glVertexPointer( 3, GL_FLOAT, 0, &buf->positions[0] );
+        glColorPointer( 4, GL_UNSIGNED_BYTE, 0, &buf->colors[0] );
+    }
+    glDrawArrays( GL_LINES, 0, 2 * g->numEdges );
+    CountDraw( 2 * (long long)g->numEdges );
+    glDisableClientState( GL_COLOR_ARRAY );
+    glDisableClientState( GL_VERTEX_ARRAY );
+
+    glEnable( GL_LIGHTING );
+}
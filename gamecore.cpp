@@ -0,0 +1,196 @@
+//	Game rules and state, with no OpenGL or GLUT
+//
+//	A GameState is everything a player changes: which level is being played,
+//	the score, the move count and the selected node.  Moves go through
+//	applyMove(), which recolors a node, keeps the level's validity counters
+//	current and scores the level the moment it is solved.  The level graphs
+//	themselves belong to whoever loaded them; the state only points at them.
+//
+//	The window code draws from a GameState and turns key presses into moves;
+//	the command-line tools drive the same API directly.
+//
+//	A game can be given a MoveJournal, which then records every move on the
+//	current level so undoGameMove( ), redoGameMove( ) and seekGameMove( ) can
+//	step through them.  The journal starts over with each level.
+//
+//	Needs graph.cpp and journal.cpp to be included first.
+
+#include <string.h>
+
+#ifndef MAX_COLORS
+#define MAX_COLORS 6
+#endif
+
+typedef struct GameState {
+    Graph *levels;              // not owned
+    int numLevels;
+    int currentLevel;
+    int score;
+    int moves;                  // over the whole game; each one costs points when a level is scored
+    int selectedNode;           // -1 if none
+    int levelSolved;            // the current level is solved and waiting for advanceLevel()
+    int gameCompleted;          // the last level is solved
+    MoveJournal *journal;       // not owned; NULL for no undo
+} GameState;
+
+typedef enum MoveResult {
+    MOVE_REJECTED,              // no such node or color, the level is already solved, or the journal cannot hold the move
+    MOVE_APPLIED,               // the node has its new color; the level is not solved yet
+    MOVE_SOLVED_LEVEL,          // this move solved the level, which has been scored
+    MOVE_SOLVED_GAME            // ... and it was the last level
+} MoveResult;
+
+typedef struct LevelScore {
+    int baseScore;
+    int colorsUsed;
+    int optimalColors;
+    int colorBonus;
+    int penalties;
+    int total;                  // what the level adds to the game score
+} LevelScore;
+
+
+// Start a game over levels[0 .. numLevels-1], clearing every coloring
+void initGame(GameState *game, Graph *levels, int numLevels) {
+    memset(game, 0, sizeof(GameState));
+    game->levels = levels;
+    game->numLevels = numLevels;
+    game->selectedNode = -1;
+    for(int l = 0; l < numLevels; l++) {
+        resetColoring(&levels[l]);
+    }
+}
+
+// Back to the first level with no score, keeping the same levels and journal
+void resetGame(GameState *game) {
+    MoveJournal *journal = game->journal;
+    initGame(game, game->levels, game->numLevels);
+    game->journal = journal;
+    if(journal != NULL) {
+        clearMoveJournal(journal);
+    }
+}
+
+Graph *currentGraph(GameState *game) {
+    return &game->levels[game->currentLevel];
+}
+
+// Score the current level as it is colored now
+LevelScore scoreLevel(const GameState *game) {
+    const Graph *graph = &game->levels[game->currentLevel];
+    LevelScore s;
+
+    // Count how many different colors were used
+    int usedColors[MAX_COLORS] = {0};
+    s.colorsUsed = 0;
+    for(int i = 0; i < graph->numNodes; i++) {
+        int color = graph->nodes[i].color;
+        if(color >= 0 && color < MAX_COLORS && usedColors[color] == 0) {
+            usedColors[color] = 1;
+            s.colorsUsed++;
+        }
+    }
+
+    // Base score: 100 points per level
+    s.baseScore = 100;
+
+    // Penalty for moves
+    s.penalties = game->moves * 2;
+
+    // Bonus for using fewer colors, and more for matching the chromatic
+    // number computed when the levels were loaded
+    s.optimalColors = graph->optimalColors;
+    s.colorBonus = 50 * (MAX_COLORS - s.colorsUsed);
+    if(s.colorsUsed == s.optimalColors) {
+        s.colorBonus += 100;
+    }
+
+    s.total = s.baseScore + s.colorBonus - s.penalties;
+    return s;
+}
+
+// Count a move that has just changed the current level and score the level
+// if it is now solved
+static MoveResult finishMove(GameState *game) {
+    Graph *graph = &game->levels[game->currentLevel];
+    game->moves++;
+    if(!isLevelSolved(*graph)) {
+        return MOVE_APPLIED;
+    }
+
+    game->score += scoreLevel(game).total;
+    if(game->score < 0) game->score = 0;
+    game->levelSolved = 1;
+    if(game->currentLevel == game->numLevels - 1) {
+        game->gameCompleted = 1;
+        return MOVE_SOLVED_GAME;
+    }
+    return MOVE_SOLVED_LEVEL;
+}
+
+// Color node with color (0 .. MAX_COLORS-1, or -1 to clear it) on the
+// current level.  Counts as a move even if the color does not change.
+// With a journal, a move it cannot record is rejected, so undo never
+// skips one.
+MoveResult applyMove(GameState *game, int node, int color) {
+    Graph *graph = &game->levels[game->currentLevel];
+    if(game->levelSolved || game->gameCompleted || node < 0 || node >= graph->numNodes ||
+       color < -1 || color >= MAX_COLORS) {
+        return MOVE_REJECTED;
+    }
+
+    if(game->journal != NULL && !recordMove(game->journal, node, graph->nodes[node].color, color)) {
+        return MOVE_REJECTED;
+    }
+    setNodeColor(graph, node, color);
+    return finishMove(game);
+}
+
+// Take back the last move on the current level.  Counts as a move; rejected
+// without a journal, with nothing to undo or once the level is solved.
+MoveResult undoGameMove(GameState *game) {
+    if(game->journal == NULL || game->levelSolved || game->gameCompleted ||
+       undoMove(game->journal, &game->levels[game->currentLevel]) == -1) {
+        return MOVE_REJECTED;
+    }
+    return finishMove(game);
+}
+
+// Make the last undone move again; it can solve the level like any move
+MoveResult redoGameMove(GameState *game) {
+    if(game->journal == NULL || game->levelSolved || game->gameCompleted ||
+       redoMove(game->journal, &game->levels[game->currentLevel]) == -1) {
+        return MOVE_REJECTED;
+    }
+    return finishMove(game);
+}
+
+// Put the current level back to how it was after the first position moves
+// on it (clamped to the moves recorded).  Counts as one move and can solve
+// the level; rejected without a journal, once the level is solved, or when
+// the level is already at that position.
+MoveResult seekGameMove(GameState *game, size_t position) {
+    if(game->journal == NULL || game->levelSolved || game->gameCompleted) {
+        return MOVE_REJECTED;
+    }
+    if(position > game->journal->entries.size()) position = game->journal->entries.size();
+    if(position == game->journal->position) {
+        return MOVE_REJECTED;
+    }
+    seekMoveJournal(game->journal, &game->levels[game->currentLevel], position);
+    return finishMove(game);
+}
+
+// Move on from a solved level to the next one, with its coloring cleared
+void advanceLevel(GameState *game) {
+    if(!game->levelSolved || game->currentLevel >= game->numLevels - 1) {
+        return;
+    }
+    game->currentLevel++;
+    game->levelSolved = 0;
+    game->selectedNode = -1;
+    resetColoring(&game->levels[game->currentLevel]);
+    if(game->journal != NULL) {
+        clearMoveJournal(game->journal);
+    }
+}
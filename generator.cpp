@@ -0,0 +1,206 @@
+//	Procedural levels with a planted coloring
+//
+//	generateLevels( ) makes random levels whose optimal color count is known
+//	without searching for it.  Every node is dealt into one of k color
+//	classes and edges only ever join different classes, so k colors always
+//	suffice; one node of each class is joined to all the others of that
+//	clique, so fewer than k never do.  The cross-class edges are a G(n, p)
+//	sample drawn with geometric skips (Batagelj-Brandes), which costs time in
+//	proportion to the edges made, not to n^2.  Node ids are dealt at random,
+//	so the classes are not visible in the numbering.
+//
+//	Levels are spread over worker threads.  Each level draws from its own
+//	random stream, seeded from the generator seed and the level number, so a
+//	seed gives the same levels whatever the thread count.
+//
+//	Needs graph.cpp, importer.cpp (assignSphereLayout) and layout.cpp to be
+//	included first.
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifndef MAX_COLORS
+#define MAX_COLORS 6
+#endif
+
+enum GeneratorLayout {
+    GEN_LAYOUT_CUBE,            // uniform in the [-1,1] cube
+    GEN_LAYOUT_SPHERE,          // evenly over the unit sphere
+    GEN_LAYOUT_FORCE            // force-directed from the sphere; slowest, reads best
+};
+
+typedef struct GeneratorOptions {
+    int numLevels;
+    int minNodes, maxNodes;     // each level's size is uniform in this range
+    int numColors;              // k: every level needs exactly this many colors
+    double density;             // chance of an edge between two nodes of different classes
+    GeneratorLayout layout;
+    float jitter;               // random offset added to every coordinate
+    int layoutIterations;       // GEN_LAYOUT_FORCE only; 0 picks by size
+    int numThreads;             // 0 = one per core
+    uint64_t seed;
+} GeneratorOptions;
+
+
+void
+defaultGeneratorOptions(GeneratorOptions *opts)
+{
+    opts->numLevels = 100;
+    opts->minNodes = 20;
+    opts->maxNodes = 60;
+    opts->numColors = 4;
+    opts->density = 0.15;
+    opts->layout = GEN_LAYOUT_SPHERE;
+    opts->jitter = 0.02f;
+    opts->layoutIterations = 0;
+    opts->numThreads = 0;
+    opts->seed = 1;
+}
+
+
+// Seed for level number level: splitmix64 of the generator seed and the level
+static uint64_t
+levelSeed(uint64_t seed, int level)
+{
+    uint64_t z = seed + 0x9e3779b97f4a7c15ULL * (uint64_t)(level + 1);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+
+// Make one level into g (which must be zeroed), drawing from rng
+static void
+generateLevel(Graph *g, const GeneratorOptions *opts, std::mt19937_64 &rng)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    int k = opts->numColors < 1 ? 1 : opts->numColors > MAX_COLORS ? MAX_COLORS : opts->numColors;
+    int minNodes = opts->minNodes > k ? opts->minNodes : k;
+    int maxNodes = opts->maxNodes > minNodes ? opts->maxNodes : minNodes;
+    int n = minNodes + (int)(rng() % (uint64_t)(maxNodes - minNodes + 1));
+
+    // deal the classes: the first k dealt nodes make the planted clique
+    std::vector<int> order(n), colorClass(n);
+    for(int i = 0; i < n; i++) order[i] = i;
+    for(int i = n - 1; i > 0; i--) std::swap(order[i], order[(size_t)(rng() % (uint64_t)(i + 1))]);
+    for(int i = 0; i < n; i++) colorClass[order[i]] = i < k ? i : (int)(rng() % (uint64_t)k);
+
+    std::vector<Edge> edges;
+    for(int a = 0; a < k; a++) {
+        for(int b = a + 1; b < k; b++) {
+            Edge e = { order[a] < order[b] ? order[a] : order[b], order[a] < order[b] ? order[b] : order[a] };
+            edges.push_back(e);
+        }
+    }
+
+    // G(n, p) over all pairs (w < v) by geometric skips, keeping cross-class pairs
+    double p = opts->density;
+    if(p > 0.0) {
+        double logq = p < 1.0 ? log(1.0 - p) : 0.0;
+        long long v = 1, w = -1;
+        while(v < n) {
+            long long skip = p < 1.0 ? (long long)floor(log(1.0 - unit(rng)) / logq) : 0;
+            w += 1 + skip;
+            while(w >= v && v < n) {
+                w -= v;
+                v++;
+            }
+            if(v < n && colorClass[v] != colorClass[w]) {
+                Edge e = { (int)w, (int)v };
+                edges.push_back(e);
+            }
+        }
+    }
+
+    // the clique edges may have been drawn again
+    std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+        return a.from < b.from || (a.from == b.from && a.to < b.to);
+    });
+    edges.erase(std::unique(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+        return a.from == b.from && a.to == b.to;
+    }), edges.end());
+
+    g->numNodes = n;
+    g->nodes = (Node *)malloc((n > 0 ? n : 1) * sizeof(Node));
+    g->numEdges = (int)edges.size();
+    g->edges = (Edge *)malloc((edges.size() > 0 ? edges.size() : 1) * sizeof(Edge));
+    if(!g->nodes || !g->edges) {
+        fprintf(stderr, "Memory allocation failed for generated level\n");
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 0; i < n; i++) {
+        g->nodes[i].id = i;
+        g->nodes[i].color = -1;
+    }
+    if(!edges.empty()) memcpy(g->edges, &edges[0], edges.size() * sizeof(Edge));
+    g->optimalColors = k;
+
+    if(opts->layout == GEN_LAYOUT_CUBE) {
+        for(int i = 0; i < n; i++) {
+            for(int a = 0; a < 3; a++) g->nodes[i].position[a] = (float)(2.0 * unit(rng) - 1.0);
+        }
+    } else {
+        assignSphereLayout(g, 1.0f);
+    }
+    if(opts->layout == GEN_LAYOUT_FORCE) {
+        buildAdjacency(g);
+        LayoutOptions layout;
+        defaultLayoutOptions(&layout, n);
+        if(opts->layoutIterations > 0) layout.iterations = opts->layoutIterations;
+        layout.numThreads = 1;      // the levels are already spread over the cores
+        computeForceLayout(g, &layout);
+    }
+    for(int i = 0; i < n && opts->jitter > 0.f; i++) {
+        for(int a = 0; a < 3; a++) g->nodes[i].position[a] += opts->jitter * (float)(2.0 * unit(rng) - 1.0);
+    }
+}
+
+
+static void
+generatorWorker(Graph *levels, const GeneratorOptions *opts, std::atomic<int> *nextLevel)
+{
+    for(;;) {
+        int level = (*nextLevel)++;
+        if(level >= opts->numLevels) break;
+        std::mt19937_64 rng(levelSeed(opts->seed, level));
+        generateLevel(&levels[level], opts, rng);
+    }
+}
+
+
+// Make opts->numLevels levels into a new array, each with optimalColors set.
+// Free each level with freeGraph( ) and then the array with free( ).
+Graph *
+generateLevels(const GeneratorOptions *opts)
+{
+    int numLevels = opts->numLevels > 0 ? opts->numLevels : 0;
+    Graph *levels = (Graph *)calloc(numLevels > 0 ? numLevels : 1, sizeof(Graph));
+    if(!levels) {
+        fprintf(stderr, "Memory allocation failed for levels\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int numThreads = opts->numThreads;
+    if(numThreads <= 0) {
+        numThreads = (int)std::thread::hardware_concurrency();
+        if(numThreads <= 0) numThreads = 1;
+    }
+    if(numThreads > numLevels) numThreads = numLevels > 0 ? numLevels : 1;
+
+    std::atomic<int> nextLevel(0);
+    std::vector<std::thread> threads;
+    for(int t = 1; t < numThreads; t++) {
+        threads.push_back(std::thread(generatorWorker, levels, opts, &nextLevel));
+    }
+    generatorWorker(levels, opts, &nextLevel);
+    for(size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    return levels;
+}
@@ -0,0 +1,161 @@
+//	Level graph data and coloring state
+//
+//	Everything here is plain C-style data with no OpenGL or GLUT dependency,
+//	so it can be shared by the game and by the command-line tools.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+typedef struct Node {
+    int id;
+    float position[3]; // x, y, z coordinates
+    int color;          // -1 for uncolored, 0 and up for colors
+} Node;
+
+typedef struct Edge {
+    int from;
+    int to;
+} Edge;
+
+typedef struct Graph {
+    Node *nodes;
+    int numNodes;
+    Edge *edges;
+    int numEdges;
+    // Compressed-sparse-row neighbor index, built once by buildAdjacency():
+    // the neighbors of node i are adjNeighbors[adjOffsets[i] .. adjOffsets[i+1]-1]
+    int *adjOffsets;    // numNodes + 1 entries
+    int *adjNeighbors;  // 2 * numEdges entries (each edge is stored in both directions)
+    // Packed adjacency bitset, built only for dense levels (bitmatrix.cpp):
+    // row i is adjMatrix[i*adjMatrixWords ..], bit j set if i and j are neighbors
+    uint64_t *adjMatrix;    // NULL when the level only has the CSR index
+    int adjMatrixWords;
+    // Running validity state, kept current by setNodeColor()
+    int numUncolored;   // nodes whose color is still -1
+    int numConflicts;   // edges whose endpoints share a color
+    int optimalColors;  // chromatic number (or best upper bound) computed at load
+    int packed;         // nodes/edges belong to a LevelPack and are not freed by freeGraph()
+} Graph;
+
+
+// Build the CSR neighbor index from the edge array.
+// Called once per level at load time; conflict queries only walk the
+// neighbors of the node being checked instead of every edge in the graph.
+void buildAdjacency(Graph *g) {
+    free(g->adjOffsets);
+    free(g->adjNeighbors);
+
+    g->adjOffsets = (int *)calloc(g->numNodes + 1, sizeof(int));
+    g->adjNeighbors = (int *)malloc((2 * g->numEdges > 0 ? 2 * g->numEdges : 1) * sizeof(int));
+    if (!g->adjOffsets || !g->adjNeighbors) {
+        fprintf(stderr, "Memory allocation failed for adjacency index\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Count the degree of every node
+    for(int i = 0; i < g->numEdges; i++) {
+        g->adjOffsets[g->edges[i].from + 1]++;
+        g->adjOffsets[g->edges[i].to + 1]++;
+    }
+
+    // Prefix sum turns degrees into row offsets
+    for(int i = 0; i < g->numNodes; i++) {
+        g->adjOffsets[i + 1] += g->adjOffsets[i];
+    }
+
+    // Scatter both directions of every edge into its row
+    int *fill = (int *)malloc((g->numNodes > 0 ? g->numNodes : 1) * sizeof(int));
+    if (!fill) {
+        fprintf(stderr, "Memory allocation failed for adjacency index\n");
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 0; i < g->numNodes; i++) {
+        fill[i] = g->adjOffsets[i];
+    }
+    for(int i = 0; i < g->numEdges; i++) {
+        int from = g->edges[i].from;
+        int to = g->edges[i].to;
+        g->adjNeighbors[fill[from]++] = to;
+        g->adjNeighbors[fill[to]++] = from;
+    }
+    free(fill);
+}
+
+void freeGraph(Graph *g) {
+    if(!g->packed) {
+        free(g->nodes);
+        free(g->edges);
+    }
+    free(g->adjOffsets);
+    free(g->adjNeighbors);
+    free(g->adjMatrix);
+    g->nodes = NULL;
+    g->edges = NULL;
+    g->adjOffsets = NULL;
+    g->adjNeighbors = NULL;
+    g->adjMatrix = NULL;
+    g->adjMatrixWords = 0;
+    g->numNodes = 0;
+    g->numEdges = 0;
+}
+
+// Clear every node's color and reset the running validity counters
+void resetColoring(Graph *g) {
+    for(int i = 0; i < g->numNodes; i++) {
+        g->nodes[i].color = -1;
+    }
+    g->numUncolored = g->numNodes;
+    g->numConflicts = 0;
+}
+
+// Recolor one node and update the counters in O(degree).
+// All color changes must go through here so isLevelSolved() stays exact.
+void setNodeColor(Graph *g, int node, int color) {
+    int oldColor = g->nodes[node].color;
+    if(oldColor == color) {
+        return;
+    }
+
+    for(int k = g->adjOffsets[node]; k < g->adjOffsets[node + 1]; k++) {
+        int neighborColor = g->nodes[g->adjNeighbors[k]].color;
+        if(neighborColor == -1) {
+            continue;
+        }
+        if(neighborColor == oldColor) {
+            g->numConflicts--;
+        }
+        if(neighborColor == color) {
+            g->numConflicts++;
+        }
+    }
+
+    if(oldColor == -1) {
+        g->numUncolored--;
+    }
+    if(color == -1) {
+        g->numUncolored++;
+    }
+    g->nodes[node].color = color;
+}
+
+// O(1): every node colored and no monochromatic edge
+int isLevelSolved(Graph graph) {
+    return graph.numUncolored == 0 && graph.numConflicts == 0;
+}
+
+// Returns the first neighbor of node that shares its color, or -1 if none.
+// Only the node's own adjacency row is inspected.
+int findConflictingNeighbor(Graph graph, int node) {
+    int color = graph.nodes[node].color;
+    if(color == -1) {
+        return -1;
+    }
+    for(int k = graph.adjOffsets[node]; k < graph.adjOffsets[node + 1]; k++) {
+        int other = graph.adjNeighbors[k];
+        if(graph.nodes[other].color == color) {
+            return other;
+        }
+    }
+    return -1;
+}
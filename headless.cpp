@@ -0,0 +1,80 @@
+//	Offscreen OpenGL context for running without a window
+//
+//	Only compiled with -DHEADLESS (and linked with -lEGL).  Asks Mesa for a
+//	surfaceless display first, which needs no X server or GPU (llvmpipe), and
+//	falls back to the default EGL display.  Rendering goes to a pbuffer of
+//	the requested size.
+//
+//	Build and run, e.g. in CI:
+//		g++ -O2 -DHEADLESS color_game.cpp -o color_game -lglut -lGLU -lGL -lEGL
+//		color_game --headless 300 level.col
+
+#ifdef HEADLESS
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+
+// Make a desktop-GL context with a width x height color+depth pbuffer current.
+// Returns false (after saying why) if EGL cannot provide one.
+bool
+CreateHeadlessContext( int width, int height )
+{
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+	if( getPlatformDisplay != NULL )
+		display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+	if( display == EGL_NO_DISPLAY )
+		display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+
+	EGLint major, minor;
+	if( display == EGL_NO_DISPLAY || !eglInitialize( display, &major, &minor ) )
+	{
+		fprintf( stderr, "Cannot initialize an EGL display\n" );
+		return false;
+	}
+	if( !eglBindAPI( EGL_OPENGL_API ) )
+	{
+		fprintf( stderr, "EGL %d.%d has no desktop OpenGL\n", major, minor );
+		return false;
+	}
+
+	const EGLint configAttribs[ ] =
+	{
+		EGL_SURFACE_TYPE,		EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE,	EGL_OPENGL_BIT,
+		EGL_RED_SIZE,			8,
+		EGL_GREEN_SIZE,			8,
+		EGL_BLUE_SIZE,			8,
+		EGL_DEPTH_SIZE,			24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs;
+	if( !eglChooseConfig( display, configAttribs, &config, 1, &numConfigs ) || numConfigs < 1 )
+	{
+		fprintf( stderr, "No EGL config with an RGB + depth pbuffer\n" );
+		return false;
+	}
+
+	const EGLint surfaceAttribs[ ] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+	EGLSurface surface = eglCreatePbufferSurface( display, config, surfaceAttribs );
+	EGLContext context = eglCreateContext( display, config, EGL_NO_CONTEXT, NULL );
+	if( surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT ||
+	    !eglMakeCurrent( display, surface, surface, context ) )
+	{
+		fprintf( stderr, "Cannot make an offscreen EGL context current (0x%x)\n", eglGetError( ) );
+		return false;
+	}
+
+	fprintf( stderr, "Headless OpenGL %s on %s\n", (const char *)glGetString( GL_VERSION ),
+		(const char *)glGetString( GL_RENDERER ) );
+	return true;
+}
+
+#endif
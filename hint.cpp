@@ -0,0 +1,383 @@
+//	Next-move hints
+//
+//	findHint( ) looks at the coloring a player has so far and suggests one
+//	node and color that still leaves the level finishable.  It searches the
+//	uncolored nodes in DSATUR order (the node with the fewest colors left
+//	goes first) with forward checking: each node keeps a bitset of the colors
+//	its colored neighbors leave open, and a choice that empties a neighbor's
+//	set is undone on the spot instead of being searched under.  Nodes are kept
+//	in buckets by how many colors they have left, so picking the next one is
+//	O(1) and a whole pass over a sparse level is O(n + m).
+//
+//	The first choice of a search that colors every node is the hint.  If the
+//	time budget runs out first, the hint is the choice the search was trying
+//	and is only known not to strand any neighbor.  A coloring with conflicts
+//	gets a fix for one of them instead, and one that cannot be finished gets
+//	a node to clear.
+//
+//	The engine keeps the last full coloring it found.  While the player's
+//	colors still agree with it, the next hint comes straight from it without
+//	searching, so a player taking hint after hint pays for one search.
+//
+//	On levels with an adjacency matrix the colors around each node come from
+//	bitset tests against the color classes instead of a walk of its row.
+//
+//	Needs graph.cpp and bitmatrix.cpp to be included first.
+
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+
+#ifndef MAX_COLORS
+#define MAX_COLORS 6
+#endif
+
+// how many colorings to try between clock checks
+const int HINT_CLOCK_INTERVAL = 256;
+
+typedef enum HintKind {
+    HINT_NONE,              // the level is already solved
+    HINT_COLOR,             // give node color; the level can be finished from there
+    HINT_GUESS,             // as HINT_COLOR, but the search ran out of time before proving it
+    HINT_FIX_CONFLICT,      // node shares its color with a neighbor; color -1 means clear it
+    HINT_BLOCKED            // the level cannot be finished from here; clear node (-1 if none helps)
+} HintKind;
+
+typedef struct Hint {
+    HintKind kind;
+    int node;
+    int color;
+    int numColors;          // colors the search was allowed
+    long long searchNodes;  // colorings tried
+    double seconds;
+} Hint;
+
+// Search state, kept between calls so a hint per frame allocates nothing
+// once the engine has seen the largest level
+typedef struct HintEngine {
+    std::vector<uint32_t> domain;       // bit c set while color c is open for an uncolored node
+    std::vector<int> color;             // the player's colors, then the search's
+    std::vector<int> bucketNext, bucketPrev;
+    int bucketHead[MAX_COLORS + 1];     // uncolored nodes by colors left
+    std::vector<int> trailNode;         // domains changed by forward checking,
+    std::vector<uint32_t> trailDomain;  // with their old values, for undo
+    std::vector<int> frameNode, frameMark;
+    std::vector<uint32_t> frameLeft;    // colors not yet tried at each level of the search
+    std::vector<int> byDegree;
+    std::vector<int> solution;          // the last full coloring found, if any
+    std::vector<uint64_t> classBits;    // the player's color classes, on matrix levels
+} HintEngine;
+
+
+static inline int
+popCount(uint32_t bits)
+{
+    return __builtin_popcount(bits);
+}
+
+static inline void
+hintBucketRemove(HintEngine *e, int v)
+{
+    int b = popCount(e->domain[v]);
+    if(e->bucketPrev[v] != -1) e->bucketNext[e->bucketPrev[v]] = e->bucketNext[v];
+    else e->bucketHead[b] = e->bucketNext[v];
+    if(e->bucketNext[v] != -1) e->bucketPrev[e->bucketNext[v]] = e->bucketPrev[v];
+}
+
+static inline void
+hintBucketInsert(HintEngine *e, int v)
+{
+    int b = popCount(e->domain[v]);
+    e->bucketPrev[v] = -1;
+    e->bucketNext[v] = e->bucketHead[b];
+    if(e->bucketHead[b] != -1) e->bucketPrev[e->bucketHead[b]] = v;
+    e->bucketHead[b] = v;
+}
+
+// Undo the assignment of v made when the trail was mark long
+static void
+hintUnassign(HintEngine *e, int v, int mark)
+{
+    while((int)e->trailNode.size() > mark) {
+        int w = e->trailNode.back();
+        hintBucketRemove(e, w);
+        e->domain[w] = e->trailDomain.back();
+        hintBucketInsert(e, w);
+        e->trailNode.pop_back();
+        e->trailDomain.pop_back();
+    }
+    e->color[v] = -1;
+    hintBucketInsert(e, v);
+}
+
+// Uncolored node with the fewest colors left, or -1 when every node is colored
+static inline int
+hintPickNode(const HintEngine *e, int numColors)
+{
+    for(int b = 1; b <= numColors; b++) {
+        if(e->bucketHead[b] != -1) return e->bucketHead[b];
+    }
+    return -1;
+}
+
+// Give v color c and take c away from its uncolored neighbors.
+// Returns 0, with nothing changed, if a neighbor is left with no colors.
+static int
+hintAssign(HintEngine *e, const Graph *g, int v, int c)
+{
+    uint32_t bit = 1u << c;
+    int mark = (int)e->trailNode.size();
+    hintBucketRemove(e, v);
+    e->color[v] = c;
+
+    for(int k = g->adjOffsets[v]; k < g->adjOffsets[v + 1]; k++) {
+        int u = g->adjNeighbors[k];
+        if(e->color[u] != -1 || (e->domain[u] & bit) == 0) continue;
+        hintBucketRemove(e, u);
+        e->trailNode.push_back(u);
+        e->trailDomain.push_back(e->domain[u]);
+        e->domain[u] &= ~bit;
+        hintBucketInsert(e, u);
+        if(e->domain[u] == 0) {
+            hintUnassign(e, v, mark);       // u is stranded; put everything back
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// A colored neighbor of v whose color no other neighbor of v has, so that
+// clearing it gives v a color back; -1 if there is none
+static int
+hintNodeToClear(const Graph *g, int v)
+{
+    int count[MAX_COLORS] = {0};
+    for(int k = g->adjOffsets[v]; k < g->adjOffsets[v + 1]; k++) {
+        int c = g->nodes[g->adjNeighbors[k]].color;
+        if(c >= 0 && c < MAX_COLORS) count[c]++;
+    }
+    for(int k = g->adjOffsets[v]; k < g->adjOffsets[v + 1]; k++) {
+        int c = g->nodes[g->adjNeighbors[k]].color;
+        if(c >= 0 && c < MAX_COLORS && count[c] == 1) return g->adjNeighbors[k];
+    }
+    return -1;
+}
+
+// Colors out of numColors that none of v's neighbors has.  classBits are
+// the color classes on a level with a matrix, or NULL to walk the CSR row.
+static uint32_t
+hintOpenColors(const Graph *g, const uint64_t *classBits, int v, int numColors)
+{
+    uint32_t open = (1u << numColors) - 1;
+    if(classBits != NULL) {
+        return open & ~matrixNeighborColors(g, classBits, numColors, v);
+    }
+    for(int k = g->adjOffsets[v]; k < g->adjOffsets[v + 1]; k++) {
+        int c = g->nodes[g->adjNeighbors[k]].color;
+        if(c >= 0 && c < numColors) open &= ~(1u << c);
+    }
+    return open;
+}
+
+
+// Hint from the last full coloring found, if it is a proper coloring of g in
+// numColors that agrees with every color the player has given.  The node is
+// the one with the fewest colors left, as the search would pick.
+static int
+hintFromSolution(const HintEngine *e, const Graph *g, const uint64_t *classBits, int numColors, Hint *hint)
+{
+    int n = g->numNodes;
+    if((int)e->solution.size() != n) return 0;
+    for(int v = 0; v < n; v++) {
+        int c = g->nodes[v].color;
+        if((c != -1 && c != e->solution[v]) || e->solution[v] < 0 || e->solution[v] >= numColors) return 0;
+    }
+    for(int i = 0; i < g->numEdges; i++) {
+        if(e->solution[g->edges[i].from] == e->solution[g->edges[i].to]) return 0;
+    }
+
+    int best = -1, bestLeft = 0, bestDegree = 0;
+    for(int v = 0; v < n; v++) {
+        if(g->nodes[v].color != -1) continue;
+        int left = popCount(hintOpenColors(g, classBits, v, numColors));
+        int degree = g->adjOffsets[v + 1] - g->adjOffsets[v];
+        if(best == -1 || left < bestLeft || (left == bestLeft && degree > bestDegree)) {
+            best = v;
+            bestLeft = left;
+            bestDegree = degree;
+        }
+    }
+    if(best == -1) return 0;
+    hint->kind = HINT_COLOR;
+    hint->node = best;
+    hint->color = e->solution[best];
+    return 1;
+}
+
+
+// Suggest the next move on g, which must have its neighbor index built.
+// numColors is the palette to finish in; 0 uses the level's optimal count,
+// or more if the player has already used more.  g is not changed.
+Hint
+findHint(HintEngine *e, const Graph *g, int numColors, double timeBudget)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int n = g->numNodes;
+    Hint hint;
+    hint.kind = HINT_NONE;
+    hint.node = -1;
+    hint.color = -1;
+    hint.searchNodes = 0;
+
+    int maxUsed = -1;
+    for(int v = 0; v < n; v++) {
+        if(g->nodes[v].color > maxUsed) maxUsed = g->nodes[v].color;
+    }
+    if(numColors <= 0) numColors = g->optimalColors > 0 ? g->optimalColors : MAX_COLORS;
+    if(numColors <= maxUsed) numColors = maxUsed + 1;
+    if(numColors > MAX_COLORS) numColors = MAX_COLORS;
+    hint.numColors = numColors;
+
+    if(isLevelSolved(*g)) {
+        hint.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return hint;
+    }
+
+    // a conflict has to go before anything can be finished
+    if(g->numConflicts > 0) {
+        for(int v = 0; v < n; v++) {
+            if(findConflictingNeighbor(*g, v) == -1) continue;
+            uint32_t open = hintOpenColors(g, NULL, v, numColors);
+            hint.kind = HINT_FIX_CONFLICT;
+            hint.node = v;
+            hint.color = open != 0 ? __builtin_ctz(open) : -1;
+            break;
+        }
+        hint.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return hint;
+    }
+
+    const uint64_t *classBits = NULL;
+    if(g->adjMatrix != NULL) {
+        buildColorClassBits(g, numColors, &e->classBits);
+        classBits = &e->classBits[0];
+    }
+
+    if(hintFromSolution(e, g, classBits, numColors, &hint)) {
+        hint.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return hint;
+    }
+
+    e->domain.resize(n);
+    e->color.resize(n);
+    e->bucketNext.resize(n);
+    e->bucketPrev.resize(n);
+    e->trailNode.clear();
+    e->trailDomain.clear();
+    e->frameNode.clear();
+    e->frameMark.clear();
+    e->frameLeft.clear();
+    for(int b = 0; b <= MAX_COLORS; b++) e->bucketHead[b] = -1;
+
+    // Bucket the uncolored nodes lowest degree first, so the highest degree
+    // ends up at the head of each bucket and wins DSATUR ties
+    int maxDegree = 0;
+    for(int v = 0; v < n; v++) {
+        int d = g->adjOffsets[v + 1] - g->adjOffsets[v];
+        if(d > maxDegree) maxDegree = d;
+    }
+    std::vector<int> &byDegree = e->byDegree;
+    byDegree.assign(maxDegree + 2, 0);
+    for(int v = 0; v < n; v++) byDegree[g->adjOffsets[v + 1] - g->adjOffsets[v] + 1]++;
+    for(int d = 0; d <= maxDegree; d++) byDegree[d + 1] += byDegree[d];
+    e->frameNode.resize(n);
+    for(int v = 0; v < n; v++) e->frameNode[byDegree[g->adjOffsets[v + 1] - g->adjOffsets[v]]++] = v;
+
+    for(int i = 0; i < n; i++) {
+        int v = e->frameNode[i];
+        e->color[v] = g->nodes[v].color;
+        if(e->color[v] != -1) continue;
+        e->domain[v] = hintOpenColors(g, classBits, v, numColors);
+        if(e->domain[v] == 0) {
+            hint.kind = HINT_BLOCKED;
+            hint.node = hintNodeToClear(g, v);
+            hint.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return hint;
+        }
+        hintBucketInsert(e, v);
+    }
+    e->frameNode.clear();
+
+    // Depth-first over DSATUR order; frame i holds the node colored at depth i
+    // and the colors it has not tried yet
+    int rootNode = -1;
+    int timedOut = 0;
+    int sinceClock = 0;
+    int v = hintPickNode(e, numColors);
+    int descend = 1;
+    while(v != -1 || !e->frameNode.empty()) {
+        if(descend) {
+            if(v == -1) break;                          // every node colored
+            e->frameNode.push_back(v);
+            e->frameMark.push_back((int)e->trailNode.size());
+            e->frameLeft.push_back(e->domain[v]);
+            if(rootNode == -1) rootNode = v;
+        }
+
+        // next color for the node on top of the stack that strands no neighbor
+        int top = (int)e->frameNode.size() - 1;
+        int u = e->frameNode[top];
+        int placed = 0;
+        while(e->frameLeft[top] != 0 && !placed) {
+            int c = __builtin_ctz(e->frameLeft[top]);
+            e->frameLeft[top] &= e->frameLeft[top] - 1;
+            hint.searchNodes++;
+            placed = hintAssign(e, g, u, c);
+            if(++sinceClock == HINT_CLOCK_INTERVAL) {
+                sinceClock = 0;
+                if(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > timeBudget) {
+                    timedOut = 1;
+                    break;
+                }
+            }
+        }
+        if(placed && top == 0) {
+            hint.node = u;
+            hint.color = e->color[u];
+        }
+        if(timedOut) break;
+
+        if(placed) {
+            v = hintPickNode(e, numColors);
+            descend = 1;
+        } else {
+            // out of colors here: back up and try the parent's next color
+            e->frameNode.pop_back();
+            e->frameMark.pop_back();
+            e->frameLeft.pop_back();
+            if(e->frameNode.empty()) break;
+            top--;
+            hintUnassign(e, e->frameNode[top], e->frameMark[top]);
+            v = -1;
+            descend = 0;
+        }
+    }
+
+    if(timedOut) {
+        hint.kind = HINT_GUESS;
+        if(hint.node == -1) {
+            hint.node = rootNode;
+            hint.color = __builtin_ctz(e->domain[rootNode]);
+        }
+    } else if(!e->frameNode.empty()) {
+        hint.kind = HINT_COLOR;
+        e->solution = e->color;
+    } else {
+        // no way to finish: free up a color for the node the search started from
+        hint.kind = HINT_BLOCKED;
+        hint.node = rootNode != -1 ? hintNodeToClear(g, rootNode) : -1;
+        hint.color = -1;
+    }
+    hint.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return hint;
+}
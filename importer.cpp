@@ -0,0 +1,259 @@
+//	Streaming importer for DIMACS .col files and plain edge lists
+//
+//	The file is read through a fixed-size buffer one chunk at a time, so the
+//	only memory that grows with the input is the edge array itself.  Edges are
+//	stored as (smaller, larger) pairs, then sorted so duplicates and self-loops
+//	can be dropped in one pass.
+//
+//	DIMACS:     "c ..." comments, "p edge <nodes> <edges>", "e <u> <v>" (1-based)
+//	Edge list:  "<u> <v>" per line (0-based), "#" or "%" comments
+//
+//	Needs graph.cpp to be included first.
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+// bytes read from the file per chunk
+const int IMPORT_CHUNK_SIZE = 1 << 20;
+
+typedef struct ImportStats {
+    long long bytes;
+    long long lines;
+    long long edgesRead;        // edge lines in the file
+    long long duplicateEdges;   // dropped because the edge was already present
+    long long selfLoops;        // dropped because both ends are the same node
+    double seconds;
+} ImportStats;
+
+
+// Spread nodes evenly over a sphere (Fibonacci spiral) so an imported level
+// has somewhere to draw every node before any real layout is computed
+void
+assignSphereLayout(Graph *g, float radius)
+{
+    const float GOLDEN_ANGLE = (float)M_PI * (3.f - sqrtf(5.f));
+    int n = g->numNodes;
+    for(int i = 0; i < n; i++) {
+        float y = n > 1 ? 1.f - 2.f * (float)i / (float)(n - 1) : 0.f;
+        float r = sqrtf(1.f - y * y);
+        float theta = GOLDEN_ANGLE * (float)i;
+        g->nodes[i].position[0] = radius * r * cosf(theta);
+        g->nodes[i].position[1] = radius * y;
+        g->nodes[i].position[2] = radius * r * sinf(theta);
+    }
+}
+
+
+static inline bool
+edgeLess(const Edge &a, const Edge &b)
+{
+    return a.from < b.from || (a.from == b.from && a.to < b.to);
+}
+
+
+// Parse one unsigned integer, skipping leading blanks.  Returns false if
+// there is none.  Values too big for a long long are clamped to LLONG_MAX,
+// which every caller's range check then rejects.
+static inline bool
+parseImportInt(const char *&p, const char *end, long long &value)
+{
+    while(p < end && (*p == ' ' || *p == '\t')) p++;
+    if(p >= end || *p < '0' || *p > '9') return false;
+    value = 0;
+    while(p < end && *p >= '0' && *p <= '9') {
+        int digit = *p - '0';
+        value = value > (LLONG_MAX - digit) / 10 ? LLONG_MAX : value * 10 + digit;
+        p++;
+    }
+    return true;
+}
+
+
+// Read a DIMACS .col or edge-list file into g.  Returns 1 on success;
+// on failure prints why and leaves g empty.  stats may be NULL.
+int
+importGraphFile(const char *path, Graph *g, ImportStats *stats)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ImportStats local;
+    memset(&local, 0, sizeof(local));
+    memset(g, 0, sizeof(Graph));
+
+    FILE *fp = fopen(path, "rb");
+    if(fp == NULL) {
+        fprintf(stderr, "Cannot open graph file '%s'\n", path);
+        return 0;
+    }
+
+    char *buffer = (char *)malloc(IMPORT_CHUNK_SIZE);
+    int capacity = 1 << 16;
+    Edge *edges = (Edge *)malloc(capacity * sizeof(Edge));
+    if(!buffer || !edges) {
+        fprintf(stderr, "Memory allocation failed for graph import\n");
+        fclose(fp);
+        free(buffer);
+        free(edges);
+        return 0;
+    }
+
+    int numEdges = 0;
+    long long declaredNodes = -1;       // from a DIMACS "p" line
+    long long maxNode = -1;
+    bool dimacs = false;
+    bool ok = true;
+    size_t carried = 0;                 // partial line kept from the previous chunk
+
+    while(ok) {
+        size_t got = fread(buffer + carried, 1, IMPORT_CHUNK_SIZE - carried, fp);
+        local.bytes += got;
+        size_t filled = carried + got;
+        bool lastChunk = got == 0 || filled < (size_t)IMPORT_CHUNK_SIZE;
+        if(filled == 0) break;
+
+        const char *p = buffer;
+        const char *end = buffer + filled;
+        while(p < end) {
+            const char *eol = (const char *)memchr(p, '\n', end - p);
+            if(eol == NULL) {
+                if(!lastChunk) break;   // finish this line with the next chunk
+                eol = end;
+            }
+            local.lines++;
+
+            const char *q = p;
+            while(q < eol && (*q == ' ' || *q == '\t')) q++;
+            long long u, v;
+            if(q == eol || *q == '\r' || *q == 'c' || *q == '#' || *q == '%') {
+                // blank line or comment
+            } else if(*q == 'p') {
+                // p <format> <nodes> <edges>
+                q++;
+                while(q < eol && (*q == ' ' || *q == '\t')) q++;
+                while(q < eol && *q != ' ' && *q != '\t') q++;
+                long long declaredEdges;
+                if(!parseImportInt(q, eol, declaredNodes) || !parseImportInt(q, eol, declaredEdges) ||
+                   declaredNodes > INT32_MAX || declaredEdges == LLONG_MAX) {
+                    fprintf(stderr, "%s:%lld: bad problem line\n", path, local.lines);
+                    ok = false;
+                    break;
+                }
+                dimacs = true;
+            } else if(*q == 'e' || (*q >= '0' && *q <= '9')) {
+                bool dimacsEdge = *q == 'e';
+                if(dimacsEdge) q++;
+                if(!parseImportInt(q, eol, u) || !parseImportInt(q, eol, v)) {
+                    fprintf(stderr, "%s:%lld: bad edge line\n", path, local.lines);
+                    ok = false;
+                    break;
+                }
+                if(dimacsEdge) {
+                    if(u < 1 || v < 1 || (declaredNodes >= 0 && (u > declaredNodes || v > declaredNodes))) {
+                        fprintf(stderr, "%s:%lld: node out of range\n", path, local.lines);
+                        ok = false;
+                        break;
+                    }
+                    u--;
+                    v--;
+                }
+                if(u > INT32_MAX - 1 || v > INT32_MAX - 1) {
+                    fprintf(stderr, "%s:%lld: node id too large\n", path, local.lines);
+                    ok = false;
+                    break;
+                }
+                local.edgesRead++;
+
+                if(u == v) {
+                    local.selfLoops++;
+                } else {
+                    if(numEdges == capacity) {
+                        if(capacity > INT32_MAX / 2) {
+                            fprintf(stderr, "%s: too many edges\n", path);
+                            ok = false;
+                            break;
+                        }
+                        Edge *grown = (Edge *)realloc(edges, (size_t)capacity * 2 * sizeof(Edge));
+                        if(!grown) {
+                            fprintf(stderr, "Memory reallocation failed for graph import\n");
+                            ok = false;
+                            break;
+                        }
+                        edges = grown;
+                        capacity *= 2;
+                    }
+                    edges[numEdges].from = (int)(u < v ? u : v);
+                    edges[numEdges].to = (int)(u < v ? v : u);
+                    numEdges++;
+                    if(u > maxNode) maxNode = u;
+                    if(v > maxNode) maxNode = v;
+                }
+            }
+            // anything else (DIMACS "n", "x", ...) is ignored
+
+            p = eol + 1;
+        }
+
+        // move the unfinished line to the front of the buffer
+        carried = p < end ? end - p : 0;
+        if(carried == (size_t)IMPORT_CHUNK_SIZE) {
+            fprintf(stderr, "%s:%lld: line longer than %d bytes\n", path, local.lines + 1, IMPORT_CHUNK_SIZE);
+            ok = false;
+        }
+        if(carried > 0) memmove(buffer, p, carried);
+        if(lastChunk && carried == 0) break;
+    }
+    fclose(fp);
+    free(buffer);
+
+    if(!ok) {
+        free(edges);
+        return 0;
+    }
+
+    if(dimacs && maxNode >= declaredNodes) {
+        fprintf(stderr, "%s: edge to node %lld but only %lld nodes declared\n", path, maxNode + 1, declaredNodes);
+        free(edges);
+        return 0;
+    }
+
+    // drop duplicate edges (including u-v / v-u pairs)
+    std::sort(edges, edges + numEdges, edgeLess);
+    int unique = 0;
+    for(int i = 0; i < numEdges; i++) {
+        if(unique > 0 && edges[unique - 1].from == edges[i].from && edges[unique - 1].to == edges[i].to) {
+            continue;
+        }
+        edges[unique++] = edges[i];
+    }
+    local.duplicateEdges = numEdges - unique;
+    numEdges = unique;
+
+    // a valid but huge node id can still ask for more than there is
+    int numNodes = (int)(dimacs ? declaredNodes : maxNode + 1);
+    Node *nodes = (Node *)malloc((size_t)(numNodes > 0 ? numNodes : 1) * sizeof(Node));
+    Edge *shrunk = (Edge *)realloc(edges, (size_t)(numEdges > 0 ? numEdges : 1) * sizeof(Edge));
+    if(shrunk) edges = shrunk;
+    if(!nodes) {
+        fprintf(stderr, "%s: not enough memory for %d nodes\n", path, numNodes);
+        free(edges);
+        return 0;
+    }
+    g->numNodes = numNodes;
+    g->nodes = nodes;
+    g->edges = edges;
+    g->numEdges = numEdges;
+    for(int i = 0; i < g->numNodes; i++) {
+        g->nodes[i].id = i;
+        g->nodes[i].color = -1;
+    }
+    assignSphereLayout(g, 1.0f);
+
+    local.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(stats != NULL) {
+        *stats = local;
+    }
+    return 1;
+}
@@ -0,0 +1,261 @@
+//	Instanced node spheres
+//
+//	Each sphere tessellation (one per level of detail) lives in a vertex
+//	buffer; each node contributes one instance (position + color) to a second
+//	buffer whose attributes advance once per instance.  All the nodes drawn
+//	with one tessellation then take a single glDrawElementsInstanced( )
+//	instead of a push/translate/color/call/pop sequence per node.
+//
+//	Needs OpenGL 3.3 (or ARB_instanced_arrays) and GLSL 1.20.  When those are
+//	missing InitNodeInstancer( ) leaves supported false and the caller keeps
+//	drawing with the sphere display list.  The shader uses the fixed-function
+//	matrices and GL_LIGHT0 so the two paths look the same.
+//
+//	Needs renderstats.cpp to be included first.
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// floats per instance: x, y, z, r, g, b
+const int NODE_INSTANCE_FLOATS = 6;
+
+// sphere tessellations one instancer can hold
+const int NODE_MAX_MESHES = 4;
+
+typedef struct NodeInstancer {
+    bool supported;
+    GLuint program;
+    GLuint meshBuffer[NODE_MAX_MESHES];     // unit sphere vertices (which double as normals)
+    GLuint indexBuffer[NODE_MAX_MESHES];
+    int numIndices[NODE_MAX_MESHES];
+    int numMeshes;
+    GLuint instanceBuffer;
+    int capacity;               // instances the instance buffer can hold
+    float radius;
+    GLint radiusLoc;
+    GLint litLoc;
+} NodeInstancer;
+
+
+#ifndef __APPLE__
+
+static const char *NODE_VERTEX_SHADER =
+    "#version 120\n"
+    "attribute vec3 aVertex;\n"
+    "attribute vec3 aOffset;\n"
+    "attribute vec3 aColor;\n"
+    "uniform float uRadius;\n"
+    "uniform int uLit;\n"
+    "void main( )\n"
+    "{\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4( aOffset + uRadius * aVertex, 1. );\n"
+    "    vec3 color = aColor;\n"
+    "    if( uLit != 0 )\n"
+    "    {\n"
+    "        // GL_COLOR_MATERIAL ambient+diffuse, global and light ambient, one directional light\n"
+    "        vec3 n = normalize( gl_NormalMatrix * aVertex );\n"
+    "        vec3 l = normalize( gl_LightSource[0].position.xyz );\n"
+    "        vec3 ambient = gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb;\n"
+    "        vec3 diffuse = gl_LightSource[0].diffuse.rgb * max( dot( n, l ), 0. );\n"
+    "        color = clamp( aColor * ( ambient + diffuse ), 0., 1. );\n"
+    "    }\n"
+    "    gl_FrontColor = vec4( color, 1. );\n"
+    "}\n";
+
+static const char *NODE_FRAGMENT_SHADER =
+    "#version 120\n"
+    "void main( )\n"
+    "{\n"
+    "    gl_FragColor = gl_Color;\n"
+    "}\n";
+
+
+static GLuint
+CompileNodeShader( GLenum type, const char *source )
+{
+    GLuint shader = glCreateShader( type );
+    glShaderSource( shader, 1, &source, NULL );
+    glCompileShader( shader );
+    GLint ok;
+    glGetShaderiv( shader, GL_COMPILE_STATUS, &ok );
+    if( !ok )
+    {
+        char log[1024];
+        glGetShaderInfoLog( shader, sizeof(log), NULL, log );
+        fprintf( stderr, "Node shader compile failed:\n%s\n", log );
+        glDeleteShader( shader );
+        return 0;
+    }
+    return shader;
+}
+
+
+static bool
+HasInstancing( )
+{
+    const char *version = (const char *)glGetString( GL_VERSION );
+    int major = 0, minor = 0;
+    if( version != NULL && sscanf( version, "%d.%d", &major, &minor ) == 2 &&
+        ( major > 3 || ( major == 3 && minor >= 3 ) ) )
+        return true;
+
+    const char *extensions = (const char *)glGetString( GL_EXTENSIONS );
+    return extensions != NULL && strstr( extensions, "GL_ARB_instanced_arrays" ) != NULL &&
+           strstr( extensions, "GL_ARB_draw_instanced" ) != NULL;
+}
+
+#endif
+
+
+// Build the shader and instance buffer.  Sphere meshes are added with
+// AddNodeInstancerMesh( ).
+void
+InitNodeInstancer( NodeInstancer *inst, float radius )
+{
+    memset( inst, 0, sizeof(NodeInstancer) );
+    inst->radius = radius;
+
+#ifndef __APPLE__
+    if( !HasInstancing( ) )
+    {
+        fprintf( stderr, "Instanced drawing not available, using display lists for nodes\n" );
+        return;
+    }
+
+    GLuint vs = CompileNodeShader( GL_VERTEX_SHADER, NODE_VERTEX_SHADER );
+    GLuint fs = CompileNodeShader( GL_FRAGMENT_SHADER, NODE_FRAGMENT_SHADER );
+    if( vs == 0 || fs == 0 )
+        return;
+
+    inst->program = glCreateProgram( );
+    glAttachShader( inst->program, vs );
+    glAttachShader( inst->program, fs );
+    glBindAttribLocation( inst->program, 0, "aVertex" );
+    glBindAttribLocation( inst->program, 1, "aOffset" );
+    glBindAttribLocation( inst->program, 2, "aColor" );
+    glLinkProgram( inst->program );
+    glDeleteShader( vs );
+    glDeleteShader( fs );
+    GLint ok;
+    glGetProgramiv( inst->program, GL_LINK_STATUS, &ok );
+    if( !ok )
+    {
+        fprintf( stderr, "Node shader link failed\n" );
+        glDeleteProgram( inst->program );
+        inst->program = 0;
+        return;
+    }
+    inst->radiusLoc = glGetUniformLocation( inst->program, "uRadius" );
+    inst->litLoc = glGetUniformLocation( inst->program, "uLit" );
+
+    glGenBuffers( 1, &inst->instanceBuffer );
+    inst->supported = true;
+#endif
+}
+
+
+// Add a sphere tessellation; slices/stacks match glutSolidSphere( ).
+// Returns the mesh number to draw it with, or -1.
+int
+AddNodeInstancerMesh( NodeInstancer *inst, int slices, int stacks )
+{
+#ifndef __APPLE__
+    if( !inst->supported || inst->numMeshes == NODE_MAX_MESHES )
+        return -1;
+
+    // unit sphere, stacks from the south pole up, slices around z like glutSolidSphere( )
+    std::vector<float> vertices;
+    for( int j = 0; j <= stacks; j++ )
+    {
+        float phi = -F_PI_2 + F_PI * (float)j / (float)stacks;
+        for( int i = 0; i <= slices; i++ )
+        {
+            float theta = F_2_PI * (float)i / (float)slices;
+            vertices.push_back( cosf( phi ) * cosf( theta ) );
+            vertices.push_back( cosf( phi ) * sinf( theta ) );
+            vertices.push_back( sinf( phi ) );
+        }
+    }
+    std::vector<GLuint> indices;
+    for( int j = 0; j < stacks; j++ )
+    {
+        for( int i = 0; i < slices; i++ )
+        {
+            GLuint a = j * ( slices + 1 ) + i;
+            GLuint b = a + slices + 1;
+            indices.push_back( a );  indices.push_back( a + 1 );  indices.push_back( b );
+            indices.push_back( b );  indices.push_back( a + 1 );  indices.push_back( b + 1 );
+        }
+    }
+
+    int mesh = inst->numMeshes++;
+    inst->numIndices[mesh] = (int)indices.size( );
+    glGenBuffers( 1, &inst->meshBuffer[mesh] );
+    glBindBuffer( GL_ARRAY_BUFFER, inst->meshBuffer[mesh] );
+    glBufferData( GL_ARRAY_BUFFER, vertices.size( ) * sizeof(float), &vertices[0], GL_STATIC_DRAW );
+    glGenBuffers( 1, &inst->indexBuffer[mesh] );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, inst->indexBuffer[mesh] );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices.size( ) * sizeof(GLuint), &indices[0], GL_STATIC_DRAW );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    return mesh;
+#else
+    return -1;
+#endif
+}
+
+
+// Draw count spheres with the given mesh.  instances holds
+// NODE_INSTANCE_FLOATS floats per node.
+void
+DrawNodeInstances( NodeInstancer *inst, int mesh, const float *instances, int count )
+{
+#ifndef __APPLE__
+    if( !inst->supported || mesh < 0 || mesh >= inst->numMeshes || count <= 0 )
+        return;
+
+    glBindBuffer( GL_ARRAY_BUFFER, inst->instanceBuffer );
+    GLsizeiptr bytes = (GLsizeiptr)count * NODE_INSTANCE_FLOATS * sizeof(float);
+    if( count > inst->capacity )
+    {
+        glBufferData( GL_ARRAY_BUFFER, bytes, instances, GL_STREAM_DRAW );
+        inst->capacity = count;
+    }
+    else
+    {
+        // orphan the old storage so we never wait on the previous frame
+        glBufferData( GL_ARRAY_BUFFER, (GLsizeiptr)inst->capacity * NODE_INSTANCE_FLOATS * sizeof(float), NULL, GL_STREAM_DRAW );
+        glBufferSubData( GL_ARRAY_BUFFER, 0, bytes, instances );
+    }
+
+    glUseProgram( inst->program );
+    glUniform1f( inst->radiusLoc, inst->radius );
+    glUniform1i( inst->litLoc, glIsEnabled( GL_LIGHTING ) ? 1 : 0 );
+
+    GLsizei stride = NODE_INSTANCE_FLOATS * sizeof(float);
+    glEnableVertexAttribArray( 1 );
+    glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)0 );
+    glVertexAttribDivisor( 1, 1 );
+    glEnableVertexAttribArray( 2 );
+    glVertexAttribPointer( 2, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)( 3 * sizeof(float) ) );
+    glVertexAttribDivisor( 2, 1 );
+
+    glBindBuffer( GL_ARRAY_BUFFER, inst->meshBuffer[mesh] );
+    glEnableVertexAttribArray( 0 );
+    glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)0 );
+
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, inst->indexBuffer[mesh] );
+    glDrawElementsInstanced( GL_TRIANGLES, inst->numIndices[mesh], GL_UNSIGNED_INT, (const GLvoid *)0, count );
+    CountDraw( (long long)inst->numIndices[mesh] * count );
+
+    glVertexAttribDivisor( 1, 0 );
+    glVertexAttribDivisor( 2, 0 );
+    glDisableVertexAttribArray( 0 );
+    glDisableVertexAttribArray( 1 );
+    glDisableVertexAttribArray( 2 );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    glUseProgram( 0 );
+#endif
+}
@@ -0,0 +1,144 @@
+//	Undo and redo for color moves
+//
+//	A MoveJournal is the list of moves made on one level, oldest first, each
+//	packed into four bytes: the node in the top 26 bits and the old and new
+//	colors (plus one, so -1 fits) in three bits each.  Moves before position
+//	are on the board; the ones after it have been undone and can be redone
+//	until a new move is recorded, which drops them.
+//
+//	Undo and redo go through setNodeColor( ), so the level's validity
+//	counters are restored in O(degree) of the one node, never by rescanning
+//	the graph.  seekMoveJournal( ) jumps to any point in the history and
+//	sets each node it passes only once, to the color it has at the target,
+//	so a jump over a million moves to a few thousand nodes costs a few
+//	thousand recolors.
+//
+//	Needs graph.cpp to be included first.
+
+#include <stdint.h>
+#include <vector>
+
+#ifndef MAX_COLORS
+#define MAX_COLORS 6
+#endif
+
+#if MAX_COLORS > 7
+#error "journal entries hold colors in three bits"
+#endif
+
+// nodes above this cannot be journaled
+const int JOURNAL_MAX_NODES = 1 << 26;
+
+typedef struct MoveJournal {
+    std::vector<uint32_t> entries;  // every recorded move, oldest first
+    size_t position;                // how many of them are on the board
+    std::vector<int> seekColor;     // seekMoveJournal( ) scratch, by node
+    std::vector<int> seekNodes;
+} MoveJournal;
+
+
+static inline uint32_t
+packMove(int node, int oldColor, int newColor)
+{
+    return (uint32_t)node << 6 | (uint32_t)(oldColor + 1) << 3 | (uint32_t)(newColor + 1);
+}
+
+static inline int
+movedNode(uint32_t entry)
+{
+    return (int)(entry >> 6);
+}
+
+static inline int
+movedFrom(uint32_t entry)
+{
+    return (int)((entry >> 3) & 7) - 1;
+}
+
+static inline int
+movedTo(uint32_t entry)
+{
+    return (int)(entry & 7) - 1;
+}
+
+
+void
+clearMoveJournal(MoveJournal *j)
+{
+    j->entries.clear();
+    j->position = 0;
+}
+
+// Record that node went from oldColor to newColor, dropping anything that
+// could have been redone.  Returns 0 if the node is out of range.
+int
+recordMove(MoveJournal *j, int node, int oldColor, int newColor)
+{
+    if(node < 0 || node >= JOURNAL_MAX_NODES) {
+        return 0;
+    }
+    j->entries.resize(j->position);
+    j->entries.push_back(packMove(node, oldColor, newColor));
+    j->position++;
+    return 1;
+}
+
+// Take back the last move on the board.  Returns its node, or -1 if there
+// is nothing to undo.
+int
+undoMove(MoveJournal *j, Graph *g)
+{
+    if(j->position == 0) {
+        return -1;
+    }
+    uint32_t entry = j->entries[--j->position];
+    setNodeColor(g, movedNode(entry), movedFrom(entry));
+    return movedNode(entry);
+}
+
+// Make the next undone move again.  Returns its node, or -1 if there is
+// nothing to redo.
+int
+redoMove(MoveJournal *j, Graph *g)
+{
+    if(j->position == j->entries.size()) {
+        return -1;
+    }
+    uint32_t entry = j->entries[j->position++];
+    setNodeColor(g, movedNode(entry), movedTo(entry));
+    return movedNode(entry);
+}
+
+// Put g as it was after the first position moves (clamped to the moves
+// recorded).  Every node touched in between is recolored once.
+void
+seekMoveJournal(MoveJournal *j, Graph *g, size_t position)
+{
+    if(position > j->entries.size()) position = j->entries.size();
+    if(position == j->position) return;
+    if((int)j->seekColor.size() < g->numNodes) j->seekColor.assign(g->numNodes, -2);
+    j->seekNodes.clear();
+
+    // going back, a node ends at the old color of the earliest move undone;
+    // going forward, at the new color of the latest move redone
+    if(position < j->position) {
+        for(size_t i = j->position; i-- > position; ) {
+            int node = movedNode(j->entries[i]);
+            if(j->seekColor[node] == -2) j->seekNodes.push_back(node);
+            j->seekColor[node] = movedFrom(j->entries[i]);
+        }
+    } else {
+        for(size_t i = j->position; i < position; i++) {
+            int node = movedNode(j->entries[i]);
+            if(j->seekColor[node] == -2) j->seekNodes.push_back(node);
+            j->seekColor[node] = movedTo(j->entries[i]);
+        }
+    }
+
+    for(size_t i = 0; i < j->seekNodes.size(); i++) {
+        int node = j->seekNodes[i];
+        setNodeColor(g, node, j->seekColor[node]);
+        j->seekColor[node] = -2;
+    }
+    j->position = position;
+}
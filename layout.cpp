@@ -0,0 +1,502 @@
+//	3D force-directed layout for levels that come without positions
+//
+//	Fruchterman-Reingold: every pair of nodes repels with k^2/d and every edge
+//	pulls its ends together with d^2/k.  The all-pairs repulsion is approximated
+//	with a Barnes-Hut octree rebuilt each iteration, the spring pass walks the
+//	CSR neighbor rows four at a time with SSE, and the nodes are split across
+//	threads for both.  Node moves are capped by a temperature that cools
+//	linearly, and the result is scaled to fit the [-1,1] cube the game draws in.
+//
+//	saveLayout( ) / loadLayout( ) store just the positions so a layout can be
+//	reused without recomputing it.  computeCachedLayout( ) keys those files by
+//	a hash of the graph's edge set, so an unchanged graph never runs the
+//	layout twice.
+//
+//	Needs graph.cpp to be included first, and the CSR index built.
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+
+#ifdef WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LAYOUT_USE_SSE 1
+#endif
+
+// past this depth coincident nodes share a leaf instead of splitting forever
+const int OCTREE_MAX_DEPTH = 24;
+
+// bodies a leaf holds before it is split
+const int OCTREE_LEAF_SIZE = 4;
+
+typedef struct LayoutOptions {
+    int iterations;
+    float theta;            // Barnes-Hut opening angle: larger is faster and coarser
+    int numThreads;         // 0 = one per core
+} LayoutOptions;
+
+typedef struct OctreeCell {
+    float center[3];        // geometric center of the cube
+    float halfSize;
+    float com[3];           // center of mass of the bodies below
+    float mass;             // number of bodies below
+    int firstChild;         // index of 8 consecutive children, or -1 for a leaf
+    int firstBody;          // leaf only: head of the body list, -1 if empty
+    int numBodies;          // leaf only: length of the body list
+} OctreeCell;
+
+
+// Pick iteration counts that keep 100k-node levels to a few seconds on a
+// multi-core machine; big graphs get fewer, coarser iterations
+void
+defaultLayoutOptions(LayoutOptions *opts, int numNodes)
+{
+    opts->iterations = numNodes <= 1000 ? 200 : numNodes <= 20000 ? 100 : 30;
+    opts->theta = numNodes <= 1000 ? 0.8f : numNodes <= 20000 ? 1.0f : 1.2f;
+    opts->numThreads = 0;
+}
+
+
+// Octree over the node positions, stored as one flat array of cells
+class LayoutOctree
+{
+public:
+    void build(const float *x, const float *y, const float *z, int n)
+    {
+        cells.clear();
+        nextBody.assign(n, -1);
+
+        float lo[3] = { 1e30f, 1e30f, 1e30f };
+        float hi[3] = { -1e30f, -1e30f, -1e30f };
+        for(int i = 0; i < n; i++) {
+            lo[0] = fminf(lo[0], x[i]); hi[0] = fmaxf(hi[0], x[i]);
+            lo[1] = fminf(lo[1], y[i]); hi[1] = fmaxf(hi[1], y[i]);
+            lo[2] = fminf(lo[2], z[i]); hi[2] = fmaxf(hi[2], z[i]);
+        }
+        OctreeCell root;
+        float half = 0.f;
+        for(int a = 0; a < 3; a++) {
+            root.center[a] = 0.5f * (lo[a] + hi[a]);
+            half = fmaxf(half, 0.5f * (hi[a] - lo[a]));
+        }
+        root.halfSize = half * 1.001f + 1e-6f;
+        root.firstChild = -1;
+        root.firstBody = -1;
+        root.numBodies = 0;
+        cells.push_back(root);
+
+        for(int i = 0; i < n; i++) {
+            insert(i, x, y, z);
+        }
+        summarize(x, y, z);
+    }
+
+    std::vector<OctreeCell> cells;
+    std::vector<int> nextBody;      // body list links for shared leaves
+
+private:
+    static int octant(const OctreeCell &c, float px, float py, float pz)
+    {
+        return (px >= c.center[0] ? 1 : 0) | (py >= c.center[1] ? 2 : 0) | (pz >= c.center[2] ? 4 : 0);
+    }
+
+    void split(int cell)
+    {
+        int first = (int)cells.size();
+        float h = cells[cell].halfSize * 0.5f;
+        for(int o = 0; o < 8; o++) {
+            OctreeCell child;
+            child.center[0] = cells[cell].center[0] + ((o & 1) ? h : -h);
+            child.center[1] = cells[cell].center[1] + ((o & 2) ? h : -h);
+            child.center[2] = cells[cell].center[2] + ((o & 4) ? h : -h);
+            child.halfSize = h;
+            child.firstChild = -1;
+            child.firstBody = -1;
+            child.numBodies = 0;
+            cells.push_back(child);
+        }
+        cells[cell].firstChild = first;
+    }
+
+    void insert(int body, const float *x, const float *y, const float *z)
+    {
+        int cell = 0;
+        for(int depth = 0; ; depth++) {
+            if(cells[cell].firstChild >= 0) {
+                cell = cells[cell].firstChild + octant(cells[cell], x[body], y[body], z[body]);
+                continue;
+            }
+            if(cells[cell].numBodies < OCTREE_LEAF_SIZE || depth >= OCTREE_MAX_DEPTH) {
+                nextBody[body] = cells[cell].firstBody;
+                cells[cell].firstBody = body;
+                cells[cell].numBodies++;
+                return;
+            }
+
+            // full leaf: push its bodies down one level and try again
+            int b = cells[cell].firstBody;
+            cells[cell].firstBody = -1;
+            cells[cell].numBodies = 0;
+            split(cell);
+            while(b >= 0) {
+                int next = nextBody[b];
+                OctreeCell &child = cells[cells[cell].firstChild + octant(cells[cell], x[b], y[b], z[b])];
+                nextBody[b] = child.firstBody;
+                child.firstBody = b;
+                child.numBodies++;
+                b = next;
+            }
+        }
+    }
+
+    // children always come after their parent, so one backwards pass works
+    void summarize(const float *x, const float *y, const float *z)
+    {
+        for(int c = (int)cells.size() - 1; c >= 0; c--) {
+            OctreeCell &cell = cells[c];
+            float m = 0.f, sx = 0.f, sy = 0.f, sz = 0.f;
+            if(cell.firstChild < 0) {
+                for(int b = cell.firstBody; b >= 0; b = nextBody[b]) {
+                    m += 1.f;
+                    sx += x[b]; sy += y[b]; sz += z[b];
+                }
+            } else {
+                for(int o = 0; o < 8; o++) {
+                    const OctreeCell &child = cells[cell.firstChild + o];
+                    m += child.mass;
+                    sx += child.com[0] * child.mass;
+                    sy += child.com[1] * child.mass;
+                    sz += child.com[2] * child.mass;
+                }
+            }
+            cell.mass = m;
+            if(m > 0.f) {
+                cell.com[0] = sx / m; cell.com[1] = sy / m; cell.com[2] = sz / m;
+            } else {
+                cell.com[0] = cell.center[0]; cell.com[1] = cell.center[1]; cell.com[2] = cell.center[2];
+            }
+        }
+    }
+};
+
+
+// Shared arrays for one layout run, structure-of-arrays so the spring pass
+// can load four neighbors at a time
+typedef struct LayoutState {
+    int n;
+    const int *offsets;
+    const int *neighbors;
+    std::vector<float> x, y, z;
+    std::vector<float> fx, fy, fz;
+    float k;                // ideal edge length
+    float theta;
+    LayoutOctree tree;
+} LayoutState;
+
+
+static void
+repulsionForces(LayoutState &s, int begin, int end)
+{
+    const float k2 = s.k * s.k;
+    const float theta2 = s.theta * s.theta;
+    const OctreeCell *cells = &s.tree.cells[0];
+    const int *nextBody = &s.tree.nextBody[0];
+    int stack[8 * OCTREE_MAX_DEPTH + 8];
+
+    for(int i = begin; i < end; i++) {
+        float px = s.x[i], py = s.y[i], pz = s.z[i];
+        float ax = 0.f, ay = 0.f, az = 0.f;
+
+        int top = 0;
+        stack[top++] = 0;
+        while(top > 0) {
+            const OctreeCell &c = cells[stack[--top]];
+            if(c.mass == 0.f) continue;
+
+            float dx = px - c.com[0], dy = py - c.com[1], dz = pz - c.com[2];
+            float d2 = dx * dx + dy * dy + dz * dz;
+            float size = 2.f * c.halfSize;
+
+            if(c.firstChild < 0) {
+                for(int b = c.firstBody; b >= 0; b = nextBody[b]) {
+                    if(b == i) continue;
+                    float bx = px - s.x[b], by = py - s.y[b], bz = pz - s.z[b];
+                    float bd2 = bx * bx + by * by + bz * bz + 1e-6f;
+                    float f = k2 / bd2;
+                    ax += bx * f; ay += by * f; az += bz * f;
+                }
+            } else if(size * size < theta2 * d2) {
+                // far enough away to treat the whole cell as one body
+                float f = k2 * c.mass / (d2 + 1e-6f);
+                ax += dx * f; ay += dy * f; az += dz * f;
+            } else {
+                for(int o = 0; o < 8; o++) {
+                    stack[top++] = c.firstChild + o;
+                }
+            }
+        }
+        s.fx[i] = ax;
+        s.fy[i] = ay;
+        s.fz[i] = az;
+    }
+}
+
+
+static void
+springForces(LayoutState &s, int begin, int end)
+{
+    const float invK = 1.f / s.k;
+    const float *x = &s.x[0], *y = &s.y[0], *z = &s.z[0];
+
+    for(int i = begin; i < end; i++) {
+        float px = x[i], py = y[i], pz = z[i];
+        float ax = 0.f, ay = 0.f, az = 0.f;
+        int e = s.offsets[i];
+        int last = s.offsets[i + 1];
+
+#ifdef LAYOUT_USE_SSE
+        __m128 vpx = _mm_set1_ps(px), vpy = _mm_set1_ps(py), vpz = _mm_set1_ps(pz);
+        __m128 vinvK = _mm_set1_ps(invK);
+        __m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps(), sz = _mm_setzero_ps();
+        for( ; e + 4 <= last; e += 4) {
+            const int *nb = &s.neighbors[e];
+            __m128 dx = _mm_sub_ps(_mm_set_ps(x[nb[3]], x[nb[2]], x[nb[1]], x[nb[0]]), vpx);
+            __m128 dy = _mm_sub_ps(_mm_set_ps(y[nb[3]], y[nb[2]], y[nb[1]], y[nb[0]]), vpy);
+            __m128 dz = _mm_sub_ps(_mm_set_ps(z[nb[3]], z[nb[2]], z[nb[1]], z[nb[0]]), vpz);
+            __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+            __m128 f = _mm_mul_ps(d, vinvK);     // |d|^2/k along the unit vector = d * |d|/k
+            sx = _mm_add_ps(sx, _mm_mul_ps(dx, f));
+            sy = _mm_add_ps(sy, _mm_mul_ps(dy, f));
+            sz = _mm_add_ps(sz, _mm_mul_ps(dz, f));
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, sx); ax = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        _mm_storeu_ps(lanes, sy); ay = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        _mm_storeu_ps(lanes, sz); az = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+        for( ; e < last; e++) {
+            int j = s.neighbors[e];
+            float dx = x[j] - px, dy = y[j] - py, dz = z[j] - pz;
+            float f = sqrtf(dx * dx + dy * dy + dz * dz) * invK;
+            ax += dx * f; ay += dy * f; az += dz * f;
+        }
+
+        s.fx[i] += ax;
+        s.fy[i] += ay;
+        s.fz[i] += az;
+    }
+}
+
+
+static void
+layoutWorker(LayoutState *s, int begin, int end)
+{
+    repulsionForces(*s, begin, end);
+    springForces(*s, begin, end);
+}
+
+
+// Lay out g's nodes in 3D, replacing their positions.  Starts from the
+// current positions, so give it a spread-out start (assignSphereLayout).
+void
+computeForceLayout(Graph *g, const LayoutOptions *opts)
+{
+    int n = g->numNodes;
+    if(n == 0) return;
+
+    int numThreads = opts->numThreads;
+    if(numThreads <= 0) {
+        numThreads = (int)std::thread::hardware_concurrency();
+        if(numThreads <= 0) numThreads = 1;
+    }
+    if(numThreads > n) numThreads = n;
+
+    LayoutState s;
+    s.n = n;
+    s.offsets = g->adjOffsets;
+    s.neighbors = g->adjNeighbors;
+    s.theta = opts->theta;
+    s.x.resize(n); s.y.resize(n); s.z.resize(n);
+    s.fx.resize(n); s.fy.resize(n); s.fz.resize(n);
+
+    // work in a cube whose volume grows with n so k stays 1
+    float side = cbrtf((float)n);
+    s.k = 1.f;
+    for(int i = 0; i < n; i++) {
+        s.x[i] = g->nodes[i].position[0] * side;
+        s.y[i] = g->nodes[i].position[1] * side;
+        s.z[i] = g->nodes[i].position[2] * side;
+    }
+
+    float temperature = 0.1f * side;
+    float cooling = temperature / (float)(opts->iterations + 1);
+    std::vector<std::thread> threads;
+    for(int iter = 0; iter < opts->iterations; iter++) {
+        s.tree.build(&s.x[0], &s.y[0], &s.z[0], n);
+
+        threads.clear();
+        for(int t = 1; t < numThreads; t++) {
+            threads.push_back(std::thread(layoutWorker, &s, (int)((long long)n * t / numThreads),
+                                          (int)((long long)n * (t + 1) / numThreads)));
+        }
+        layoutWorker(&s, 0, n / numThreads);
+        for(size_t t = 0; t < threads.size(); t++) {
+            threads[t].join();
+        }
+
+        // move each node along its force, no further than the temperature
+        for(int i = 0; i < n; i++) {
+            float f = sqrtf(s.fx[i] * s.fx[i] + s.fy[i] * s.fy[i] + s.fz[i] * s.fz[i]);
+            if(f > 0.f) {
+                float step = fminf(f, temperature) / f;
+                s.x[i] += s.fx[i] * step;
+                s.y[i] += s.fy[i] * step;
+                s.z[i] += s.fz[i] * step;
+            }
+        }
+        temperature -= cooling;
+    }
+
+    // fit the result into [-1,1] around the origin
+    float lo[3] = { 1e30f, 1e30f, 1e30f };
+    float hi[3] = { -1e30f, -1e30f, -1e30f };
+    for(int i = 0; i < n; i++) {
+        lo[0] = fminf(lo[0], s.x[i]); hi[0] = fmaxf(hi[0], s.x[i]);
+        lo[1] = fminf(lo[1], s.y[i]); hi[1] = fmaxf(hi[1], s.y[i]);
+        lo[2] = fminf(lo[2], s.z[i]); hi[2] = fmaxf(hi[2], s.z[i]);
+    }
+    float extent = fmaxf(hi[0] - lo[0], fmaxf(hi[1] - lo[1], hi[2] - lo[2]));
+    float scale = extent > 0.f ? 2.f / extent : 1.f;
+    for(int i = 0; i < n; i++) {
+        g->nodes[i].position[0] = (s.x[i] - 0.5f * (lo[0] + hi[0])) * scale;
+        g->nodes[i].position[1] = (s.y[i] - 0.5f * (lo[1] + hi[1])) * scale;
+        g->nodes[i].position[2] = (s.z[i] - 0.5f * (lo[2] + hi[2])) * scale;
+    }
+}
+
+
+const char LAYOUT_MAGIC[4] = { 'C', 'G', 'L', 'Y' };
+
+// Write g's node positions to path.  Returns 1 on success.
+int
+saveLayout(const char *path, const Graph *g)
+{
+    FILE *fp = fopen(path, "wb");
+    if(fp == NULL) {
+        fprintf(stderr, "Cannot open layout file '%s' for writing\n", path);
+        return 0;
+    }
+    uint32_t numNodes = g->numNodes;
+    int ok = fwrite(LAYOUT_MAGIC, 1, 4, fp) == 4 && fwrite(&numNodes, sizeof(numNodes), 1, fp) == 1;
+    for(int i = 0; i < g->numNodes && ok; i++) {
+        ok = fwrite(g->nodes[i].position, sizeof(float), 3, fp) == 3;
+    }
+    if(fclose(fp) != 0) ok = 0;
+    if(!ok) {
+        fprintf(stderr, "Error writing layout file '%s'\n", path);
+    }
+    return ok;
+}
+
+
+// Read positions saved by saveLayout( ) into g.  Returns 1 on success, 0 if
+// the file is missing or was saved for a different node count.
+int
+loadLayout(const char *path, Graph *g)
+{
+    FILE *fp = fopen(path, "rb");
+    if(fp == NULL) return 0;
+
+    char magic[4];
+    uint32_t numNodes;
+    int ok = fread(magic, 1, 4, fp) == 4 && memcmp(magic, LAYOUT_MAGIC, 4) == 0 &&
+             fread(&numNodes, sizeof(numNodes), 1, fp) == 1 && numNodes == (uint32_t)g->numNodes;
+    std::vector<float> positions;
+    if(ok) {
+        positions.resize(3 * (size_t)numNodes + 1);
+        ok = fread(&positions[0], sizeof(float), 3 * (size_t)numNodes, fp) == 3 * (size_t)numNodes;
+    }
+    fclose(fp);
+    if(!ok) return 0;
+
+    for(int i = 0; i < g->numNodes; i++) {
+        g->nodes[i].position[0] = positions[3 * i + 0];
+        g->nodes[i].position[1] = positions[3 * i + 1];
+        g->nodes[i].position[2] = positions[3 * i + 2];
+    }
+    return 1;
+}
+
+
+// Bump when the layout algorithm changes so old cache entries are ignored
+const uint64_t LAYOUT_CACHE_VERSION = 1;
+
+static inline uint64_t
+mixLayoutHash(uint64_t x)
+{
+    // splitmix64 finalizer
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+
+// 128-bit hash of the node count and edge set.  Each edge is hashed as
+// (smaller, larger) and the results are combined with + and ^, so neither
+// edge order nor edge direction changes the key.
+void
+hashGraphEdges(const Graph *g, uint64_t hash[2])
+{
+    uint64_t sum = 0, xr = 0;
+    for(int e = 0; e < g->numEdges; e++) {
+        uint32_t a = g->edges[e].from, b = g->edges[e].to;
+        uint64_t key = a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+        sum += mixLayoutHash(key);
+        xr ^= mixLayoutHash(key ^ 0x5bd1e9955bd1e995ULL);
+    }
+    uint64_t header = ((uint64_t)(uint32_t)g->numNodes << 32) ^ (uint64_t)(uint32_t)g->numEdges;
+    hash[0] = mixLayoutHash(sum ^ mixLayoutHash(header ^ LAYOUT_CACHE_VERSION));
+    hash[1] = mixLayoutHash(xr + mixLayoutHash(header + LAYOUT_CACHE_VERSION));
+}
+
+
+// Use the cached layout for g from cacheDir if there is one, otherwise
+// compute it and store it there.  Returns 1 on a cache hit.
+int
+computeCachedLayout(Graph *g, const LayoutOptions *opts, const char *cacheDir)
+{
+    uint64_t hash[2];
+    hashGraphEdges(g, hash);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%016llx%016llx.layout", cacheDir,
+             (unsigned long long)hash[0], (unsigned long long)hash[1]);
+    if(loadLayout(path, g)) {
+        return 1;
+    }
+
+    computeForceLayout(g, opts);
+
+#ifdef WIN32
+    _mkdir(cacheDir);
+#else
+    mkdir(cacheDir, 0755);
+#endif
+    // write under a temporary name so a crash never leaves half a file behind
+    char tmpPath[1040];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    if(saveLayout(tmpPath, g)) {
+        remove(path);
+        rename(tmpPath, path);
+    }
+    return 0;
+}
@@ -0,0 +1,286 @@
+//	Binary level packs
+//
+//	A level pack holds any number of levels in one file that is memory-mapped
+//	at startup.  Edges are used straight out of the mapping and all the nodes of
+//	all levels share one allocation, so loading does no per-level parsing and
+//	no per-node allocation.
+//
+//	Layout (little-endian, every section 8-byte aligned):
+//		LevelPackHeader
+//		LevelPackEntry[ numLevels ]
+//		per level:  float positions[ numNodes ][3], padded to 8 bytes
+//		            int   edges[ numEdges ][2]   (from, to), padded to 8 bytes
+//
+//	Needs graph.cpp to be included first.
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char LEVELPACK_MAGIC[4] = { 'C', 'G', 'L', 'P' };
+const uint32_t LEVELPACK_VERSION = 1;
+
+typedef struct LevelPackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t numLevels;
+    uint32_t reserved;
+} LevelPackHeader;
+
+typedef struct LevelPackEntry {
+    uint32_t numNodes;
+    uint32_t numEdges;
+    int32_t optimalColors;      // 0 if not known when the pack was written
+    uint32_t flags;
+    uint64_t positionsOffset;   // from the start of the file
+    uint64_t edgesOffset;
+} LevelPackEntry;
+
+typedef struct LevelPack {
+    void *data;                 // the mapped file
+    size_t size;
+    Node *nodeArena;            // nodes of every level, back to back
+    Graph *levels;
+    int numLevels;
+} LevelPack;
+
+
+static uint64_t
+alignPackOffset(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+
+// Write graphs to path as a level pack.  Returns 1 on success.
+int
+writeLevelPack(const char *path, const Graph *graphs, int numGraphs)
+{
+    FILE *fp = fopen(path, "wb");
+    if(fp == NULL) {
+        fprintf(stderr, "Cannot open level pack '%s' for writing\n", path);
+        return 0;
+    }
+
+    LevelPackHeader header;
+    memcpy(header.magic, LEVELPACK_MAGIC, 4);
+    header.version = LEVELPACK_VERSION;
+    header.numLevels = numGraphs;
+    header.reserved = 0;
+
+    LevelPackEntry *entries = (LevelPackEntry *)calloc(numGraphs > 0 ? numGraphs : 1, sizeof(LevelPackEntry));
+    if(!entries) {
+        fprintf(stderr, "Memory allocation failed for level pack directory\n");
+        fclose(fp);
+        return 0;
+    }
+
+    uint64_t offset = alignPackOffset(sizeof(LevelPackHeader) + numGraphs * sizeof(LevelPackEntry));
+    for(int i = 0; i < numGraphs; i++) {
+        entries[i].numNodes = graphs[i].numNodes;
+        entries[i].numEdges = graphs[i].numEdges;
+        entries[i].optimalColors = graphs[i].optimalColors;
+        entries[i].flags = 0;
+        entries[i].positionsOffset = offset;
+        offset = alignPackOffset(offset + (uint64_t)graphs[i].numNodes * 3 * sizeof(float));
+        entries[i].edgesOffset = offset;
+        offset = alignPackOffset(offset + (uint64_t)graphs[i].numEdges * 2 * sizeof(int32_t));
+    }
+
+    static const char zeros[8] = { 0 };
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && fwrite(entries, sizeof(LevelPackEntry), numGraphs, fp) == (size_t)numGraphs;
+    uint64_t written = sizeof(LevelPackHeader) + numGraphs * sizeof(LevelPackEntry);
+    for(int i = 0; i < numGraphs && ok; i++) {
+        ok = ok && fwrite(zeros, 1, entries[i].positionsOffset - written, fp) == entries[i].positionsOffset - written;
+        written = entries[i].positionsOffset;
+        for(int n = 0; n < graphs[i].numNodes && ok; n++) {
+            ok = fwrite(graphs[i].nodes[n].position, sizeof(float), 3, fp) == 3;
+        }
+        written += (uint64_t)graphs[i].numNodes * 3 * sizeof(float);
+
+        ok = ok && fwrite(zeros, 1, entries[i].edgesOffset - written, fp) == entries[i].edgesOffset - written;
+        written = entries[i].edgesOffset;
+        for(int e = 0; e < graphs[i].numEdges && ok; e++) {
+            int32_t pair[2] = { graphs[i].edges[e].from, graphs[i].edges[e].to };
+            ok = fwrite(pair, sizeof(int32_t), 2, fp) == 2;
+        }
+        written += (uint64_t)graphs[i].numEdges * 2 * sizeof(int32_t);
+    }
+    ok = ok && fwrite(zeros, 1, offset - written, fp) == offset - written;
+
+    free(entries);
+    if(fclose(fp) != 0) ok = 0;
+    if(!ok) {
+        fprintf(stderr, "Error writing level pack '%s'\n", path);
+    }
+    return ok;
+}
+
+
+static void *
+mapLevelPackFile(const char *path, size_t *size)
+{
+#ifdef WIN32
+    FILE *fp = fopen(path, "rb");
+    if(fp == NULL) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    void *data = length > 0 ? malloc(length) : NULL;
+    if(data != NULL && fread(data, 1, length, fp) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    *size = data != NULL ? (size_t)length : 0;
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return NULL;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return NULL;
+    *size = st.st_size;
+    return data;
+#endif
+}
+
+
+static void
+unmapLevelPackFile(void *data, size_t size)
+{
+#ifdef WIN32
+    free(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+
+// Does path start with the level pack magic?
+int
+isLevelPackFile(const char *path)
+{
+    char magic[4];
+    FILE *fp = fopen(path, "rb");
+    if(fp == NULL) return 0;
+    int isPack = fread(magic, 1, 4, fp) == 4 && memcmp(magic, LEVELPACK_MAGIC, 4) == 0;
+    fclose(fp);
+    return isPack;
+}
+
+
+// Free the node arena and level array and unmap the file.
+// Each level's adjacency index must already have been released with freeGraph().
+void
+closeLevelPack(LevelPack *pack)
+{
+    if(pack->data != NULL) {
+        unmapLevelPackFile(pack->data, pack->size);
+    }
+    free(pack->nodeArena);
+    free(pack->levels);
+    memset(pack, 0, sizeof(LevelPack));
+}
+
+
+// Map a level pack and point a Graph at each level.
+// Returns 1 on success; on failure prints why and leaves pack empty.
+int
+openLevelPack(const char *path, LevelPack *pack)
+{
+    memset(pack, 0, sizeof(LevelPack));
+    pack->data = mapLevelPackFile(path, &pack->size);
+    if(pack->data == NULL) {
+        fprintf(stderr, "Cannot open level pack '%s'\n", path);
+        return 0;
+    }
+
+    const char *base = (const char *)pack->data;
+    const LevelPackHeader *header = (const LevelPackHeader *)base;
+    if(pack->size < sizeof(LevelPackHeader) || memcmp(header->magic, LEVELPACK_MAGIC, 4) != 0 ||
+       header->version != LEVELPACK_VERSION ||
+       header->numLevels > (pack->size - sizeof(LevelPackHeader)) / sizeof(LevelPackEntry)) {
+        fprintf(stderr, "'%s' is not a version %u level pack\n", path, LEVELPACK_VERSION);
+        closeLevelPack(pack);
+        return 0;
+    }
+    const LevelPackEntry *entries = (const LevelPackEntry *)(base + sizeof(LevelPackHeader));
+
+    // Check every section lies inside the file before touching any of it
+    uint64_t totalNodes = 0;
+    for(uint32_t i = 0; i < header->numLevels; i++) {
+        // offset first, then the bytes left after it, so a huge offset cannot wrap
+        const LevelPackEntry *entry = &entries[i];
+        if(entry->numNodes > INT32_MAX || entry->numEdges > INT32_MAX ||
+           (entry->positionsOffset & 7) != 0 || (entry->edgesOffset & 7) != 0 ||
+           entry->positionsOffset > pack->size || entry->edgesOffset > pack->size ||
+           (uint64_t)entry->numNodes * 3 * sizeof(float) > pack->size - entry->positionsOffset ||
+           (uint64_t)entry->numEdges * 2 * sizeof(int32_t) > pack->size - entry->edgesOffset) {
+            fprintf(stderr, "Level %u of '%s' is out of bounds\n", i + 1, path);
+            closeLevelPack(pack);
+            return 0;
+        }
+        totalNodes += entry->numNodes;
+    }
+
+    pack->numLevels = header->numLevels;
+    pack->levels = (Graph *)calloc(pack->numLevels > 0 ? pack->numLevels : 1, sizeof(Graph));
+    pack->nodeArena = (Node *)malloc((totalNodes > 0 ? totalNodes : 1) * sizeof(Node));
+    if(!pack->levels || !pack->nodeArena) {
+        fprintf(stderr, "Memory allocation failed for level pack '%s'\n", path);
+        closeLevelPack(pack);
+        return 0;
+    }
+
+    Node *nextNode = pack->nodeArena;
+    for(int i = 0; i < pack->numLevels; i++) {
+        const LevelPackEntry *entry = &entries[i];
+        Graph *g = &pack->levels[i];
+        g->numNodes = entry->numNodes;
+        g->numEdges = entry->numEdges;
+        g->optimalColors = entry->optimalColors;
+        g->packed = 1;
+
+        const float *positions = (const float *)(base + entry->positionsOffset);
+        g->nodes = nextNode;
+        for(int n = 0; n < g->numNodes; n++) {
+            g->nodes[n].id = n;
+            g->nodes[n].position[0] = positions[3 * n + 0];
+            g->nodes[n].position[1] = positions[3 * n + 1];
+            g->nodes[n].position[2] = positions[3 * n + 2];
+            g->nodes[n].color = -1;
+        }
+        nextNode += g->numNodes;
+
+        // Edge is two ints, the same layout as the file, so use the mapping directly
+        g->edges = (Edge *)(base + entry->edgesOffset);
+        for(int e = 0; e < g->numEdges; e++) {
+            if(g->edges[e].from < 0 || g->edges[e].from >= g->numNodes ||
+               g->edges[e].to < 0 || g->edges[e].to >= g->numNodes) {
+                fprintf(stderr, "Level %d of '%s' has an edge to a missing node\n", i + 1, path);
+                closeLevelPack(pack);
+                return 0;
+            }
+            // a node in its own neighbor row would throw off the conflict count
+            if(g->edges[e].from == g->edges[e].to) {
+                fprintf(stderr, "Level %d of '%s' has a node joined to itself\n", i + 1, path);
+                closeLevelPack(pack);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,32 @@
+//	Per-frame draw counters
+//
+//	Every place that issues a draw call adds to FrameStats, so a frame's
+//	cost can be reported as calls and vertices without a GPU profiler.
+//	Display( ) clears the counters at the start of each frame.
+//
+//	RedrawStats counts whole frames instead: how many the window drew, and
+//	how many of those were asked for because something on screen changed.
+//	The difference is frames drawn for nothing.
+
+typedef struct RenderStats {
+    long long drawCalls;
+    long long vertices;         // vertices submitted, counting every instance
+} RenderStats;
+
+RenderStats FrameStats;
+
+
+static inline void
+CountDraw( long long vertices )
+{
+    FrameStats.drawCalls++;
+    FrameStats.vertices += vertices;
+}
+
+typedef struct RedrawCounters {
+    long long requests;         // PostRedraw( ) calls
+    long long rendered;         // frames drawn
+    long long needed;           // frames drawn with the scene marked dirty
+} RedrawCounters;
+
+RedrawCounters RedrawStats;
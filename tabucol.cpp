@@ -0,0 +1,296 @@
+//	Tabu-search coloring for levels too big to solve exactly
+//
+//	improveColoringTabu( ) takes a proper coloring (usually the greedy upper
+//	bound from computeChromaticNumber( )) and tries to find one with fewer
+//	colors, TabuCol style: drop to k-1 colors, then keep moving one
+//	conflicting node to the color that removes the most conflicts, with
+//	recently undone moves forbidden for a while so the search cannot cycle.
+//	When the conflicts reach zero the level has a (k-1)-coloring and the
+//	search drops a color again.
+//
+//	Each node keeps one row of k counters: how many of its neighbors have
+//	each color.  A move touches two counters in every neighbor's row, so the
+//	rows are stored node by node and each update is one cache line.  Moves
+//	are picked from the list of conflicting nodes only.
+//
+//	Workers search from the same best coloring with their own random
+//	streams, and start again from the shared best when another worker beats
+//	them or their own search stalls.  The search stops at the time budget or
+//	when it reaches the lower bound.
+//
+//	Needs graph.cpp and chromatic.cpp to be included first.
+
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// iterations without a new fewest-conflicts count before a worker starts over
+const long long TABU_STALL_ITERATIONS = 200000;
+
+// most conflicting nodes one move looks at; past this, a random run of them
+const int TABU_MAX_CANDIDATES = 256;
+
+// how many iterations to run between clock checks
+const int TABU_CLOCK_INTERVAL = 1024;
+
+typedef struct TabuResult {
+    int numColors;          // colors in the best coloring found
+    int startColors;        // colors in the coloring it started from
+    long long iterations;   // moves made, over all workers
+    int restarts;           // times a worker started over from the shared best
+    double seconds;
+} TabuResult;
+
+typedef struct TabuShared {
+    Graph graph;
+    int lowerBound;
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<int> bestColors;
+    std::mutex bestLock;
+    std::vector<int> bestColoring;
+    std::atomic<long long> iterations;
+    std::atomic<int> restarts;
+} TabuShared;
+
+// One worker's search at a fixed color count k
+typedef struct TabuWorker {
+    int k;
+    std::vector<int> color;
+    std::vector<int> gamma;             // gamma[v*k + c]: neighbors of v colored c
+    std::vector<long long> tabuUntil;   // tabuUntil[v*k + c]: v may not go back to c before this
+    std::vector<int> conflicted;        // nodes with a neighbor of their own color
+    std::vector<int> conflictPos;       // where each node is in conflicted, or -1
+    long long conflicts;                // monochromatic edges
+    std::mt19937 rng;
+} TabuWorker;
+
+
+static inline void
+tabuMarkConflicted(TabuWorker *w, int v, int isConflicted)
+{
+    if(isConflicted && w->conflictPos[v] == -1) {
+        w->conflictPos[v] = (int)w->conflicted.size();
+        w->conflicted.push_back(v);
+    } else if(!isConflicted && w->conflictPos[v] != -1) {
+        int last = w->conflicted.back();
+        w->conflicted[w->conflictPos[v]] = last;
+        w->conflictPos[last] = w->conflictPos[v];
+        w->conflicted.pop_back();
+        w->conflictPos[v] = -1;
+    }
+}
+
+// Start w at k colors from a proper coloring with more: nodes with a color
+// of k or above take whichever remaining color their neighbors use least
+static void
+tabuStart(TabuWorker *w, const Graph *g, const int *coloring, int k)
+{
+    int n = g->numNodes;
+    w->k = k;
+    w->color.assign(coloring, coloring + n);
+    w->gamma.assign((size_t)n * k, 0);
+    w->tabuUntil.assign((size_t)n * k, 0);
+    w->conflicted.clear();
+    w->conflictPos.assign(n, -1);
+    w->conflicts = 0;
+
+    for(int v = 0; v < n; v++) {
+        if(w->color[v] >= k) w->color[v] = -1;
+    }
+    for(int v = 0; v < n; v++) {
+        int c = w->color[v];
+        if(c < 0) continue;
+        for(int j = g->adjOffsets[v]; j < g->adjOffsets[v + 1]; j++) {
+            w->gamma[(size_t)g->adjNeighbors[j] * k + c]++;
+        }
+    }
+    for(int v = 0; v < n; v++) {
+        if(w->color[v] != -1) continue;
+        const int *row = &w->gamma[(size_t)v * k];
+        int best = (int)(w->rng() % (unsigned int)k);
+        for(int c = 0; c < k; c++) {
+            if(row[c] < row[best]) best = c;
+        }
+        w->color[v] = best;
+        for(int j = g->adjOffsets[v]; j < g->adjOffsets[v + 1]; j++) {
+            w->gamma[(size_t)g->adjNeighbors[j] * k + best]++;
+        }
+    }
+
+    for(int v = 0; v < n; v++) {
+        int own = w->gamma[(size_t)v * k + w->color[v]];
+        w->conflicts += own;
+        tabuMarkConflicted(w, v, own > 0);
+    }
+    w->conflicts /= 2;
+}
+
+// Give v color c, keeping every neighbor's row and conflict state current
+static void
+tabuMove(TabuWorker *w, const Graph *g, int v, int c)
+{
+    int k = w->k;
+    int old = w->color[v];
+    int *row = &w->gamma[(size_t)v * k];
+    w->conflicts += row[c] - row[old];
+    w->color[v] = c;
+    tabuMarkConflicted(w, v, row[c] > 0);
+
+    for(int j = g->adjOffsets[v]; j < g->adjOffsets[v + 1]; j++) {
+        int u = g->adjNeighbors[j];
+        int *urow = &w->gamma[(size_t)u * k];
+        urow[old]--;
+        urow[c]++;
+        int uc = w->color[u];
+        if(uc == old || uc == c) tabuMarkConflicted(w, u, urow[uc] > 0);
+    }
+}
+
+// Run tabu search at w->k colors until the conflicts reach zero (returns 1),
+// or the clock, the shared best or a stall stops it (returns 0)
+static int
+tabuSearch(TabuWorker *w, const Graph *g, TabuShared *sh)
+{
+    int k = w->k;
+    long long bestConflicts = w->conflicts;
+    long long lastGain = 0;
+    long long iter = 0;
+    int sinceClock = 0;
+
+    while(w->conflicts > 0) {
+        if(++sinceClock == TABU_CLOCK_INTERVAL) {
+            sinceClock = 0;
+            sh->iterations += TABU_CLOCK_INTERVAL;
+            if(std::chrono::steady_clock::now() >= sh->deadline || sh->bestColors.load() <= k) return 0;
+        }
+        if(iter - lastGain > TABU_STALL_ITERATIONS) return 0;
+        iter++;
+
+        // best non-tabu move over the conflicting nodes; a tabu move is
+        // allowed if it beats the best count seen (aspiration)
+        int moveNode = -1, moveColor = -1, ties = 0;
+        int bestDelta = 0x7fffffff;
+        int numConflicted = (int)w->conflicted.size();
+        int numCandidates = numConflicted < TABU_MAX_CANDIDATES ? numConflicted : TABU_MAX_CANDIDATES;
+        int first = numCandidates < numConflicted ? (int)(w->rng() % (unsigned int)numConflicted) : 0;
+        for(int i = 0; i < numCandidates; i++) {
+            int v = w->conflicted[(first + i) % numConflicted];
+            const int *row = &w->gamma[(size_t)v * k];
+            const long long *tabu = &w->tabuUntil[(size_t)v * k];
+            int own = row[w->color[v]];
+            for(int c = 0; c < k; c++) {
+                if(c == w->color[v]) continue;
+                int delta = row[c] - own;
+                if(delta > bestDelta) continue;
+                if(tabu[c] > iter && w->conflicts + delta >= bestConflicts) continue;
+                if(delta < bestDelta) {
+                    bestDelta = delta;
+                    ties = 1;
+                    moveNode = v;
+                    moveColor = c;
+                } else if(w->rng() % (unsigned int)(++ties) == 0) {
+                    moveNode = v;
+                    moveColor = c;
+                }
+            }
+        }
+        if(moveNode == -1) {
+            // every move is tabu: take a random one
+            moveNode = w->conflicted[w->rng() % (unsigned int)w->conflicted.size()];
+            moveColor = (w->color[moveNode] + 1 + (int)(w->rng() % (unsigned int)(k - 1))) % k;
+        }
+
+        int old = w->color[moveNode];
+        tabuMove(w, g, moveNode, moveColor);
+        // tenure from Galinier and Hao: a little noise plus 0.6 per conflicting node
+        w->tabuUntil[(size_t)moveNode * k + old] = iter + (long long)(w->rng() % 10) + (long long)(0.6 * w->conflicted.size());
+        if(w->conflicts < bestConflicts) {
+            bestConflicts = w->conflicts;
+            lastGain = iter;
+        }
+    }
+    sh->iterations += sinceClock;
+    return 1;
+}
+
+static void
+tabuWorkerLoop(TabuShared *sh, int id, unsigned int seed)
+{
+    const Graph *g = &sh->graph;
+    TabuWorker w;
+    w.rng.seed(seed + 7919u * (unsigned int)id);
+    std::vector<int> start;
+
+    while(std::chrono::steady_clock::now() < sh->deadline) {
+        int k;
+        {
+            std::lock_guard<std::mutex> lock(sh->bestLock);
+            k = sh->bestColors.load() - 1;
+            start = sh->bestColoring;
+        }
+        if(k < sh->lowerBound || k < (g->numEdges > 0 ? 2 : 1)) break;
+
+        tabuStart(&w, g, &start[0], k);
+        if(tabuSearch(&w, g, sh)) {
+            std::lock_guard<std::mutex> lock(sh->bestLock);
+            if(k < sh->bestColors.load()) {
+                sh->bestColoring = w.color;
+                sh->bestColors = k;
+            }
+        } else if(std::chrono::steady_clock::now() < sh->deadline) {
+            sh->restarts++;
+        }
+    }
+}
+
+
+// Try to recolor graph (neighbor index built) in fewer colors than the proper
+// coloring it is given, which has startColors colors, for up to timeBudget
+// seconds on numThreads threads (0 = one per core).  Stops early on reaching
+// lowerBound.  coloring is replaced by the best coloring found.
+TabuResult
+improveColoringTabu(Graph graph, int *coloring, int startColors, int lowerBound,
+                    double timeBudget, int numThreads, unsigned int seed)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    TabuResult result = {startColors, startColors, 0, 0, 0.0};
+    int n = graph.numNodes;
+    if(n == 0 || startColors <= 1 || startColors <= lowerBound) {
+        return result;
+    }
+
+    if(numThreads <= 0) {
+        numThreads = (int)std::thread::hardware_concurrency();
+        if(numThreads <= 0) numThreads = 1;
+    }
+
+    TabuShared sh;
+    sh.graph = graph;
+    sh.lowerBound = lowerBound;
+    sh.deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(timeBudget));
+    sh.bestColors = startColors;
+    sh.bestColoring.assign(coloring, coloring + n);
+    sh.iterations = 0;
+    sh.restarts = 0;
+
+    std::vector<std::thread> threads;
+    for(int i = 1; i < numThreads; i++) {
+        threads.push_back(std::thread(tabuWorkerLoop, &sh, i, seed));
+    }
+    tabuWorkerLoop(&sh, 0, seed);
+    for(size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    memcpy(coloring, &sh.bestColoring[0], n * sizeof(int));
+    result.numColors = sh.bestColors.load();
+    result.iterations = sh.iterations.load();
+    result.restarts = sh.restarts.load();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
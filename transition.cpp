@@ -0,0 +1,291 @@
+//	Node paths for level transitions, in structure-of-arrays form
+//
+//	Every node follows a path of keyframes at times shared by all nodes.  The
+//	keys are stored one array per axis per key, padded to a multiple of four
+//	nodes, so evaluateTransitionPaths( ) finds the key segment once for time t
+//	and then interpolates every node with one pass of four-wide SSE over
+//	contiguous floats.  The result is written as interleaved xyz, the layout
+//	the node BVH and the instance buffers take, so the game evaluates the
+//	paths once per animation step and both drawing and picking read that.
+//
+//	planTransition( ) works out the paths between two levels of any sizes.
+//	Nodes are paired by nearest-neighbor assignment: in each round every
+//	unpaired node of the smaller level proposes its nearest free node of the
+//	other, and proposals are accepted shortest first.  A node left
+//	over in the current level despawns by flying into its nearest node of
+//	the next; a node left over in the next level spawns out of the nearest
+//	node of the current one.  The game plans every transition when the
+//	levels are loaded, so starting one costs only copying the colors.
+//
+//	No OpenGL here, so the command-line tools can use it too.
+//	Needs graph.cpp and bvh.cpp to be included first.
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRANSITION_USE_SSE 1
+#endif
+
+typedef struct TransitionPaths {
+    int numNodes;
+    int numKeys;
+    int stride;                 // numNodes rounded up to a multiple of 4
+    std::vector<float> times;   // numKeys, increasing
+    std::vector<float> keys;    // axis a of key k for node i is at (3*k + a) * stride + i
+} TransitionPaths;
+
+
+// Size paths for numNodes nodes and numKeys keyframes, all at time 0 and the origin
+void
+initTransitionPaths(TransitionPaths *paths, int numNodes, int numKeys)
+{
+    paths->numNodes = numNodes;
+    paths->numKeys = numKeys;
+    paths->stride = (numNodes + 3) & ~3;
+    paths->times.assign(numKeys, 0.f);
+    paths->keys.assign((size_t)numKeys * 3 * paths->stride, 0.f);
+}
+
+// The numNodes values of one axis (0 = x, 1 = y, 2 = z) at keyframe key
+float *
+transitionKey(TransitionPaths *paths, int key, int axis)
+{
+    return &paths->keys[(size_t)(3 * key + axis) * paths->stride];
+}
+
+// Set keyframe key of every node from interleaved xyz positions
+void
+setTransitionKey(TransitionPaths *paths, int key, float time, const float *positions)
+{
+    paths->times[key] = time;
+    float *x = transitionKey(paths, key, 0);
+    float *y = transitionKey(paths, key, 1);
+    float *z = transitionKey(paths, key, 2);
+    for(int i = 0; i < paths->numNodes; i++) {
+        x[i] = positions[3 * i];
+        y[i] = positions[3 * i + 1];
+        z[i] = positions[3 * i + 2];
+    }
+}
+
+// Write every node's position at time t to positions (3 * numNodes floats).
+// Times before the first key or after the last are held at that key.
+void
+evaluateTransitionPaths(const TransitionPaths *paths, float t, float *positions)
+{
+    int n = paths->numNodes;
+    if(n == 0 || paths->numKeys == 0) return;
+
+    // the segment is the same for every node
+    int k = 0;
+    while(k < paths->numKeys - 2 && t > paths->times[k + 1]) k++;
+    int k1 = paths->numKeys > 1 ? k + 1 : k;
+    float span = paths->times[k1] - paths->times[k];
+    float u = span > 0.f ? (t - paths->times[k]) / span : 1.f;
+    if(u < 0.f) u = 0.f;
+    if(u > 1.f) u = 1.f;
+
+    const float *a[3], *b[3];
+    for(int axis = 0; axis < 3; axis++) {
+        a[axis] = &paths->keys[(size_t)(3 * k + axis) * paths->stride];
+        b[axis] = &paths->keys[(size_t)(3 * k1 + axis) * paths->stride];
+    }
+
+    int i = 0;
+#ifdef TRANSITION_USE_SSE
+    __m128 uu = _mm_set1_ps(u);
+    for(; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(a[0] + i);
+        __m128 y = _mm_loadu_ps(a[1] + i);
+        __m128 z = _mm_loadu_ps(a[2] + i);
+        x = _mm_add_ps(x, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b[0] + i), x), uu));
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b[1] + i), y), uu));
+        z = _mm_add_ps(z, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b[2] + i), z), uu));
+
+        // four nodes of x, y and z become x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+        __m128 xyLo = _mm_unpacklo_ps(x, y);                            // x0 y0 x1 y1
+        __m128 xyHi = _mm_unpackhi_ps(x, y);                            // x2 y2 x3 y3
+        __m128 zx = _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0));      // z0 z0 x1 x1
+        __m128 yz = _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1));      // y1 y1 z1 z1
+        __m128 zxHi = _mm_shuffle_ps(z, xyHi, _MM_SHUFFLE(2, 2, 2, 2)); // z2 z2 x3 x3
+        __m128 yzHi = _mm_shuffle_ps(xyHi, z, _MM_SHUFFLE(3, 3, 3, 3)); // y3 y3 z3 z3
+        float *out = positions + 3 * i;
+        _mm_storeu_ps(out, _mm_shuffle_ps(xyLo, zx, _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_storeu_ps(out + 4, _mm_shuffle_ps(yz, xyHi, _MM_SHUFFLE(1, 0, 2, 0)));
+        _mm_storeu_ps(out + 8, _mm_shuffle_ps(zxHi, yzHi, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+#endif
+    for(; i < n; i++) {
+        for(int axis = 0; axis < 3; axis++) {
+            positions[3 * i + axis] = a[axis][i] + (b[axis][i] - a[axis][i]) * u;
+        }
+    }
+}
+
+
+typedef struct TransitionPlan {
+    TransitionPaths paths;      // one path per morph node, from time 0 to time 1
+    std::vector<Node> nodes;    // morph nodes as drawn: id is the index, color set by startTransition()
+    std::vector<int> source;    // node of the current level each morph node shows the color of, -1 if spawned
+    int numMatched;
+    int numSpawned;             // next-level nodes with no partner
+    int numDespawned;           // current-level nodes with no partner
+} TransitionPlan;
+
+typedef struct TransitionProposal {
+    float distance2;
+    int a, b;                   // proposing node, and the node it wants
+    int slot;                   // b's item in the tree of free nodes
+} TransitionProposal;
+
+
+static void
+graphPositions(const Graph *g, std::vector<float> *positions)
+{
+    positions->resize((size_t)g->numNodes * 3);
+    for(int i = 0; i < g->numNodes; i++) {
+        memcpy(&(*positions)[(size_t)i * 3], g->nodes[i].position, 3 * sizeof(float));
+    }
+}
+
+// Pair every node of a (na nodes) with a different node of b (nb >= na
+// nodes), nearest first; partnerA[i] is the node of b that a's node i gets.
+// The smaller side proposes, so free nodes to propose to stay plentiful, and
+// the tree over b's free nodes is rebuilt whenever half of them are taken so
+// queries never wade through taken ones.
+static void
+matchNearest(const float *aPos, int na, const float *bPos, int nb, std::vector<int> *partnerA)
+{
+    partnerA->assign(na, -1);
+    std::vector<char> taken(nb, 0);
+    std::vector<int> freeNodes;
+    std::vector<float> freePos;
+    std::vector<char> skip;
+    std::vector<TransitionProposal> proposals;
+    NodeBvh tree;
+    int numFree = 0;
+    int matched = 0;
+    while(matched < na) {
+        if(freeNodes.empty() || 2 * numFree < (int)freeNodes.size()) {
+            freeNodes.clear();
+            freePos.clear();
+            for(int j = 0; j < nb; j++) {
+                if(taken[j]) continue;
+                freeNodes.push_back(j);
+                freePos.insert(freePos.end(), bPos + 3 * (size_t)j, bPos + 3 * (size_t)j + 3);
+            }
+            numFree = (int)freeNodes.size();
+            buildNodeBvh(&tree, &freePos[0], numFree, 0.f);
+            skip.assign(numFree, 0);
+        }
+
+        proposals.clear();
+        for(int i = 0; i < na; i++) {
+            if((*partnerA)[i] != -1) continue;
+            const float *p = aPos + 3 * (size_t)i;
+            int slot = bvhNearestCenter(&tree, p, &skip[0]);
+            int j = freeNodes[slot];
+            const float *q = bPos + 3 * (size_t)j;
+            TransitionProposal proposal = { (p[0] - q[0]) * (p[0] - q[0]) + (p[1] - q[1]) * (p[1] - q[1]) +
+                                            (p[2] - q[2]) * (p[2] - q[2]), i, j, slot };
+            proposals.push_back(proposal);
+        }
+        std::sort(proposals.begin(), proposals.end(), [](const TransitionProposal &x, const TransitionProposal &y) {
+            return x.distance2 < y.distance2 || (x.distance2 == y.distance2 && x.a < y.a);
+        });
+
+        // the shortest proposal always wins, so every round pairs at least one node
+        for(size_t k = 0; k < proposals.size(); k++) {
+            const TransitionProposal *proposal = &proposals[k];
+            if(taken[proposal->b]) continue;
+            taken[proposal->b] = 1;
+            skip[proposal->slot] = 1;
+            (*partnerA)[proposal->a] = proposal->b;
+            numFree--;
+            matched++;
+        }
+    }
+}
+
+// Plan the morph from level from to level to.  Morph node j < to->numNodes
+// ends on node j of the next level; the rest are despawning nodes of from.
+void
+planTransition(const Graph *from, const Graph *to, TransitionPlan *plan)
+{
+    int nf = from->numNodes, nt = to->numNodes;
+    std::vector<float> fromPos, toPos;
+    graphPositions(from, &fromPos);
+    graphPositions(to, &toPos);
+
+    std::vector<int> partnerOfTo(nt, -1), partnerOfFrom(nf, -1);
+    if(nf <= nt) {
+        matchNearest(fromPos.empty() ? NULL : &fromPos[0], nf, toPos.empty() ? NULL : &toPos[0], nt, &partnerOfFrom);
+        for(int i = 0; i < nf; i++) partnerOfTo[partnerOfFrom[i]] = i;
+    } else {
+        matchNearest(toPos.empty() ? NULL : &toPos[0], nt, &fromPos[0], nf, &partnerOfTo);
+        for(int j = 0; j < nt; j++) partnerOfFrom[partnerOfTo[j]] = j;
+    }
+    int matched = nf < nt ? nf : nt;
+
+    // unpaired nodes spawn from, or despawn into, the nearest node of the other level
+    NodeBvh fromTree, toTree;
+    if(nt > matched) buildNodeBvh(&fromTree, fromPos.empty() ? NULL : &fromPos[0], nf, 0.f);
+    if(nf > matched) buildNodeBvh(&toTree, toPos.empty() ? NULL : &toPos[0], nt, 0.f);
+
+    int despawned = nf - matched;
+    int m = nt + despawned;
+    plan->numMatched = matched;
+    plan->numSpawned = nt - matched;
+    plan->numDespawned = despawned;
+    plan->nodes.resize(m);
+    plan->source.resize(m);
+    std::vector<float> start((size_t)m * 3), end((size_t)m * 3);
+
+    for(int j = 0; j < nt; j++) {
+        int i = partnerOfTo[j];
+        plan->source[j] = i;
+        if(i == -1) {
+            // spawn out of the nearest node of the current level
+            i = bvhNearestCenter(&fromTree, &toPos[(size_t)j * 3], NULL);
+        }
+        if(i == -1) memcpy(&start[(size_t)j * 3], &toPos[(size_t)j * 3], 3 * sizeof(float));
+        else memcpy(&start[(size_t)j * 3], &fromPos[(size_t)i * 3], 3 * sizeof(float));
+        memcpy(&end[(size_t)j * 3], &toPos[(size_t)j * 3], 3 * sizeof(float));
+    }
+    int k = nt;
+    for(int i = 0; i < nf; i++) {
+        if(partnerOfFrom[i] != -1) continue;
+        // despawn into the nearest node of the next level
+        int j = bvhNearestCenter(&toTree, &fromPos[(size_t)i * 3], NULL);
+        plan->source[k] = i;
+        memcpy(&start[(size_t)k * 3], &fromPos[(size_t)i * 3], 3 * sizeof(float));
+        if(j == -1) memcpy(&end[(size_t)k * 3], &fromPos[(size_t)i * 3], 3 * sizeof(float));
+        else memcpy(&end[(size_t)k * 3], &toPos[(size_t)j * 3], 3 * sizeof(float));
+        k++;
+    }
+
+    for(int n = 0; n < m; n++) {
+        plan->nodes[n].id = n;
+        plan->nodes[n].color = -1;
+        memcpy(plan->nodes[n].position, &end[(size_t)n * 3], 3 * sizeof(float));
+    }
+    initTransitionPaths(&plan->paths, m, 2);
+    if(m > 0) {
+        setTransitionKey(&plan->paths, 0, 0.f, &start[0]);
+        setTransitionKey(&plan->paths, 1, 1.f, &end[0]);
+    }
+}
+
+// Give the morph nodes the colors of the nodes they come from in from, as
+// colored now; spawning nodes are uncolored
+void
+startTransition(TransitionPlan *plan, const Graph *from)
+{
+    for(size_t n = 0; n < plan->nodes.size(); n++) {
+        int i = plan->source[n];
+        plan->nodes[n].color = i >= 0 && i < from->numNodes ? from->nodes[i].color : -1;
+    }
+}